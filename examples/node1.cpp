@@ -7,7 +7,8 @@
 
 #include "node1.h"
 
-uint8_t groups[] = {1, 3};
+/* Ends with a zero, begin() refuses more than NODE_MAX_GROUPS groups */
+uint8_t groups[NODE_MAX_GROUPS + 1] = {1, 3};
 
 RF24 radio(CE_PIN, CSN_PIN);
 RF24Network network(radio);
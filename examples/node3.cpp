@@ -7,7 +7,8 @@
 
 #include "node3.h"
 
-uint8_t groups[] = {3, 5};
+/* Ends with a zero, begin() refuses more than NODE_MAX_GROUPS groups */
+uint8_t groups[NODE_MAX_GROUPS + 1] = {3, 5};
 
 RF24 radio(CE_PIN, CSN_PIN);
 RF24Network network(radio);
@@ -21,6 +22,13 @@ RF24Wave wave(radio, network, mesh, NODE_ID, groups);
 MyMessage msg(1, V_STATUS);
 bool status = false;
 
+void onLight(const MyMessage &message);
+
+/* Other messages are dropped by the library before their value is decoded */
+static constexpr sensor_route_t routes[] = {
+  {WAVE_ANY, V_LIGHT, C_SET, onLight},
+};
+
 void setup(){
   Serial.begin(115200);
   Serial.println(F("Boot in waiting, press any touch to launch boot sequence !"));
@@ -28,6 +36,7 @@ void setup(){
   ; // wait for serial port to connect. Needed for native USB
   }
   Serial.println(F("Boot amorced !"));
+  wave.setHandlers(routes);
   wave.begin();
   delay(3000);
   wave.sendSketchInfo("Node 3", "1.0");
@@ -50,17 +59,15 @@ void loop(){
   }
 }
 
-void receive(const MyMessage &message){
-  if (message.type == V_LIGHT) {
-    bool lightState = message.getBool();
-    if (lightState) {
-      Serial.println(F("Change state to ON"));
-      status = true;
-    }else{
-      Serial.println(F("Change state to OFF"));
-      status = false;
-    }
-    msg.set(status);
-    wave.send(msg);
+void onLight(const MyMessage &message){
+  bool lightState = message.getBool();
+  if (lightState) {
+    Serial.println(F("Change state to ON"));
+    status = true;
+  }else{
+    Serial.println(F("Change state to OFF"));
+    status = false;
   }
+  msg.set(status);
+  wave.send(msg);
 }
@@ -0,0 +1,24 @@
+#include <RF24.h>
+#include <RF24Network.h>
+#include <RF24Mesh.h>
+#include <SPI.h>
+#include <RF24Wave.h>
+#include <MyMessage.h>
+
+#include "repeater.h"
+
+RF24 radio(CE_PIN, CSN_PIN);
+RF24Network network(radio);
+RF24Mesh mesh(radio, network);
+/* Built with WAVE_REPEATER: in no group, only relays frames of its children */
+RF24Wave wave(radio, network, mesh, NODE_ID);
+
+void setup(){
+  Serial.begin(115200);
+  Serial.println(F("Repeater boot !"));
+  wave.begin();
+}
+
+void loop(){
+  wave.listen();
+}
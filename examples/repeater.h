@@ -0,0 +1,9 @@
+#ifndef __REPEATER_H
+#define __REPEATER_H
+
+#define CE_PIN 9
+#define CSN_PIN 10
+
+#define NODE_ID 50
+
+#endif
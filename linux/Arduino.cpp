@@ -0,0 +1,239 @@
+/**
+ * \file Arduino.cpp
+ * \brief Arduino compatibility layer for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ */
+#include "Arduino.h"
+#include <errno.h>
+#include <unistd.h>
+
+LinuxSerial Serial;
+
+/***************************** Conversions **********************************/
+
+char *ultoa(unsigned long value, char *buffer, int base)
+{
+  char tmp[sizeof(unsigned long) * 8 + 1];
+  uint8_t i = 0, j = 0;
+  do{
+    uint8_t digit = value % base;
+    tmp[i++] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  }while(value);
+  while(i){
+    buffer[j++] = tmp[--i];
+  }
+  buffer[j] = 0;
+  return buffer;
+}
+
+char *ltoa(long value, char *buffer, int base)
+{
+  if(value < 0 && base == 10){
+    buffer[0] = '-';
+    ultoa(-(unsigned long)value, buffer + 1, base);
+    return buffer;
+  }
+  return ultoa((unsigned long)value, buffer, base);
+}
+
+char *itoa(int value, char *buffer, int base)
+{
+  return ltoa(value, buffer, base);
+}
+
+char *utoa(unsigned int value, char *buffer, int base)
+{
+  return ultoa(value, buffer, base);
+}
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *buffer)
+{
+  sprintf(buffer, "%*.*f", width, precision, value);
+  return buffer;
+}
+
+long random(long howbig)
+{
+  return howbig > 0 ? rand() % howbig : 0;
+}
+
+void randomSeed(unsigned long seed)
+{
+  if(seed != 0){
+    srand(seed);
+  }
+}
+
+int analogRead(uint8_t pin)
+{
+  (void)pin;
+  return rand() & 0x3FF;
+}
+
+/***************************** Serial ***************************************/
+
+LinuxSerial::LinuxSerial():
+_rxHead(0), _rxCount(0), _txHead(0), _txCount(0), _dropped(0)
+{
+}
+
+void LinuxSerial::begin(unsigned long baud)
+{
+  (void)baud;
+}
+
+int LinuxSerial::available()
+{
+  return _rxCount;
+}
+
+int LinuxSerial::availableForWrite()
+{
+  return SERIAL_TX_SIZE - _txCount;
+}
+
+int LinuxSerial::read()
+{
+  char c;
+  if(!_rxCount){
+    return -1;
+  }
+  c = _rx[_rxHead];
+  _rxHead = (_rxHead + 1) % SERIAL_RX_SIZE;
+  _rxCount--;
+  return (uint8_t)c;
+}
+
+size_t LinuxSerial::write(uint8_t c)
+{
+  if(_txCount >= SERIAL_TX_SIZE){
+    _dropped++;
+    return 0;
+  }
+  _tx[(_txHead + _txCount) % SERIAL_TX_SIZE] = c;
+  _txCount++;
+  return 1;
+}
+
+size_t LinuxSerial::write(const char *str)
+{
+  size_t n = 0;
+  while(*str){
+    n += write((uint8_t)*str++);
+  }
+  return n;
+}
+
+size_t LinuxSerial::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while(size--){
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t LinuxSerial::print(const char *str)
+{
+  return write(str);
+}
+
+size_t LinuxSerial::print(const __FlashStringHelper *str)
+{
+  return write(reinterpret_cast<const char *>(str));
+}
+
+size_t LinuxSerial::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t LinuxSerial::print(unsigned char n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+size_t LinuxSerial::print(int n, int base)
+{
+  return print((long)n, base);
+}
+
+size_t LinuxSerial::print(unsigned int n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+size_t LinuxSerial::print(long n, int base)
+{
+  char buffer[sizeof(long) * 8 + 2];
+  return write(ltoa(n, buffer, base));
+}
+
+size_t LinuxSerial::print(unsigned long n, int base)
+{
+  char buffer[sizeof(long) * 8 + 1];
+  return write(ultoa(n, buffer, base));
+}
+
+size_t LinuxSerial::print(double n, int digits)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+  return write(buffer);
+}
+
+size_t LinuxSerial::println()
+{
+  return write("\r\n");
+}
+
+void LinuxSerial::feed(const char *data, size_t length)
+{
+  size_t i;
+  for(i=0; i<length; i++){
+    if(_rxCount >= SERIAL_RX_SIZE){
+      _dropped++;
+      return;
+    }
+    _rx[(_rxHead + _rxCount) % SERIAL_RX_SIZE] = data[i];
+    _rxCount++;
+  }
+}
+
+size_t LinuxSerial::pending()
+{
+  return _txCount;
+}
+
+ssize_t LinuxSerial::flushTo(int fd)
+{
+  ssize_t written, total = 0;
+  size_t chunk;
+  while(_txCount){
+    /* Contiguous part of the ring buffer */
+    chunk = min(_txCount, (size_t)(SERIAL_TX_SIZE - _txHead));
+    written = ::write(fd, &_tx[_txHead], chunk);
+    if(written < 0){
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
+        break;
+      }
+      return -1;
+    }
+    _txHead = (_txHead + written) % SERIAL_TX_SIZE;
+    _txCount -= written;
+    total += written;
+    if((size_t)written < chunk){
+      break;
+    }
+  }
+  return total;
+}
+
+uint32_t LinuxSerial::dropped()
+{
+  return _dropped;
+}
@@ -0,0 +1,143 @@
+/**
+ * \file Arduino.h
+ * \brief Arduino compatibility layer for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Provides the small part of the Arduino core used by RF24Wave and
+ * MyMessage. Serial is backed by memory buffers which are filled and
+ * drained by the event loop of gateway.cpp.
+ *
+ */
+
+#ifndef __LINUX_ARDUINO_H
+#define __LINUX_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+#ifndef PSTR
+#define PSTR(x) (x)
+#endif
+
+#ifndef snprintf_P
+#define snprintf_P snprintf
+#endif
+
+#ifndef vsnprintf_P
+#define vsnprintf_P vsnprintf
+#endif
+
+class __FlashStringHelper;
+#define F(x) (reinterpret_cast<const __FlashStringHelper *>(x))
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/**
+ * @def SERIAL_RX_SIZE
+ * @brief Size of buffer holding bytes received from controller.
+ */
+#ifndef SERIAL_RX_SIZE
+#define SERIAL_RX_SIZE (4096u)
+#endif
+
+/**
+ * @def SERIAL_TX_SIZE
+ * @brief Size of buffer holding bytes waiting to be written to controller.
+ */
+#ifndef SERIAL_TX_SIZE
+#define SERIAL_TX_SIZE (65536u)
+#endif
+
+#ifndef min
+template <typename T> inline T min(T a, T b) { return a < b ? a : b; }
+#endif
+#ifndef max
+template <typename T> inline T max(T a, T b) { return a > b ? a : b; }
+#endif
+
+typedef uint8_t byte;
+
+/* Provided by RF24 on Linux, or by the radio stand-in */
+uint32_t millis(void);
+#ifndef delayMicroseconds
+void delayMicroseconds(unsigned int us);
+#endif
+
+char *itoa(int value, char *buffer, int base);
+char *utoa(unsigned int value, char *buffer, int base);
+char *ltoa(long value, char *buffer, int base);
+char *ultoa(unsigned long value, char *buffer, int base);
+char *dtostrf(double value, signed char width, unsigned char precision, char *buffer);
+long random(long howbig);
+void randomSeed(unsigned long seed);
+
+/* Floating input: noise from rand(), so a seeded scenario runs the same */
+#define A0 14
+int analogRead(uint8_t pin);
+
+class LinuxSerial
+{
+  public:
+    LinuxSerial();
+
+/***************************** Arduino API **********************************/
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int availableForWrite();
+    size_t write(uint8_t c);
+    size_t write(const char *str);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *str);
+    size_t print(const __FlashStringHelper *str);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t println();
+    template <typename T>
+    size_t println(T value)
+    {
+      return print(value) + println();
+    }
+    template <typename T>
+    size_t println(T value, int format)
+    {
+      return print(value, format) + println();
+    }
+
+/***************************** Event loop API *******************************/
+    void feed(const char *data, size_t length);
+    size_t pending();
+    ssize_t flushTo(int fd);
+    uint32_t dropped();
+
+  private:
+    char _rx[SERIAL_RX_SIZE];
+    size_t _rxHead;
+    size_t _rxCount;
+    char _tx[SERIAL_TX_SIZE];
+    size_t _txHead;
+    size_t _txCount;
+    uint32_t _dropped;
+};
+
+extern LinuxSerial Serial;
+
+#endif
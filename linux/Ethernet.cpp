@@ -0,0 +1,134 @@
+/**
+ * \file Ethernet.cpp
+ * \brief Arduino Ethernet API over POSIX sockets for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ */
+#include "Ethernet.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+/***************************** EthernetClient *******************************/
+
+EthernetClient::EthernetClient():
+_fd(-1)
+{
+}
+
+EthernetClient::EthernetClient(int fd):
+_fd(fd)
+{
+}
+
+EthernetClient::operator bool()
+{
+  return _fd >= 0;
+}
+
+uint8_t EthernetClient::connected()
+{
+  char c;
+  ssize_t length;
+  if(_fd < 0){
+    return 0;
+  }
+  /* Like Arduino, a closed client stays connected while data is left */
+  length = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if(length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+int EthernetClient::available()
+{
+  int count = 0;
+  if(_fd < 0 || ioctl(_fd, FIONREAD, &count) < 0){
+    return 0;
+  }
+  return count;
+}
+
+int EthernetClient::read()
+{
+  uint8_t c;
+  if(_fd < 0 || recv(_fd, &c, 1, MSG_DONTWAIT) != 1){
+    return -1;
+  }
+  return c;
+}
+
+size_t EthernetClient::write(const uint8_t *buffer, size_t size)
+{
+  ssize_t length;
+  if(_fd < 0){
+    return 0;
+  }
+  length = send(_fd, buffer, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if(length < 0){
+    if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+      stop();
+    }
+    return 0;
+  }
+  return length;
+}
+
+void EthernetClient::stop()
+{
+  if(_fd >= 0){
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+/***************************** EthernetServer *******************************/
+
+EthernetServer::EthernetServer(uint16_t port):
+_port(port), _fd(-1)
+{
+}
+
+void EthernetServer::begin()
+{
+  struct sockaddr_in addr;
+  int enable = 1;
+  _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if(_fd < 0){
+    perror("socket");
+    return;
+  }
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(_port);
+  if(bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(_fd, 4) < 0){
+    perror("bind");
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+EthernetClient EthernetServer::accept()
+{
+  int enable = 1;
+  int fd;
+  if(_fd < 0){
+    return EthernetClient();
+  }
+  fd = ::accept4(_fd, NULL, NULL, SOCK_NONBLOCK);
+  if(fd < 0){
+    return EthernetClient();
+  }
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  return EthernetClient(fd);
+}
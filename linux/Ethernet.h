@@ -0,0 +1,47 @@
+/**
+ * \file Ethernet.h
+ * \brief Arduino Ethernet API over POSIX sockets for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Only the part used by the TCP controller transport of RF24Wave is
+ * provided. Every socket is non-blocking, so the gateway loop never waits
+ * on a client.
+ *
+ */
+
+#ifndef __LINUX_ETHERNET_H
+#define __LINUX_ETHERNET_H
+
+#include <Arduino.h>
+
+class EthernetClient
+{
+  public:
+    EthernetClient();
+    EthernetClient(int fd);
+    operator bool();
+    uint8_t connected();
+    int available();
+    int read();
+    size_t write(const uint8_t *buffer, size_t size);
+    void stop();
+
+  private:
+    int _fd;
+};
+
+class EthernetServer
+{
+  public:
+    EthernetServer(uint16_t port);
+    void begin();
+    EthernetClient accept();
+
+  private:
+    uint16_t _port;
+    int _fd;
+};
+
+#endif
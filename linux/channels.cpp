@@ -0,0 +1,143 @@
+/**
+ * \file channels.cpp
+ * \brief Channel survey of master and channel scan of a node on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master and once as node, both with WAVE_CHANNEL_SCAN, see
+ * SCENARIO in the Makefile. Every surveyed channel carries foreign traffic
+ * but two, WAVE_CHANNEL among the noisiest:
+ *  - master must settle on the first of the two quiet channels.
+ *  - a node trying WAVE_CHANNEL first must find master by scanning, join
+ *    its group and get a value through.
+ * Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-channels [-v]
+ *   -v  Print serial output of master and node
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Channel master must select: first one without foreign traffic */
+#define CHANNELS_QUIET          115
+/** Delay in ms of simulated time for the node to find master and join */
+#define CHANNELS_JOIN           10000
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+uint8_t masterChannel();
+bool masterIsPresent(uint8_t NID, uint8_t GID);
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+uint8_t masterChannel()
+{
+  return radio.getChannel();
+}
+
+bool masterIsPresent(uint8_t NID, uint8_t GID)
+{
+  return wave.isPresent(NID, GID);
+}
+
+#else
+/***************************** Node unit ************************************/
+
+typedef struct{
+  uint8_t channel;
+  /* Percent of carrier detect samples with foreign traffic */
+  uint8_t noise;
+}channels_noise_t;
+
+/* Channels CHANNEL_SCAN_MIN to CHANNEL_SCAN_MAX, quiet ones tie */
+static const channels_noise_t noise[] = {
+  {90, 40}, {95, 20}, {100, 60}, {105, 80}, {110, 90}, {115, 0}, {120, 0}, {125, 10},
+};
+
+/* Commands of master, none in this scenario */
+void receive(const MyMessage &message)
+{
+  (void)message;
+}
+
+int main(int argc, char **argv)
+{
+  SimNode *node;
+  MyMessage message(1, V_TEMP);
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i;
+  uint32_t now = 1;
+  int out, n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  for(i=0; i<sizeof(noise)/sizeof(noise[0]); i++){
+    simSetNoise(noise[i].channel, noise[i].noise);
+  }
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  Serial.flushTo(out);
+  if(masterChannel() != CHANNELS_QUIET){
+    fprintf(stderr, "Master on channel %d, expected %d\n", masterChannel(), CHANNELS_QUIET);
+    return 1;
+  }
+
+  /* Node tries WAVE_CHANNEL first, where master is not */
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(1, groups);
+  while(!node->step() && now < CHANNELS_JOIN){
+    simSetClock(++now);
+    masterListen();
+    Serial.flushTo(out);
+  }
+  if(!node->wave.isSynchronized() || !masterIsPresent(1, 1)){
+    fprintf(stderr, "Node not synchronized on channel %d\n", node->radio.getChannel());
+    return 1;
+  }
+  if(node->radio.getChannel() != CHANNELS_QUIET){
+    fprintf(stderr, "Node on channel %d, master on %d\n", node->radio.getChannel(), CHANNELS_QUIET);
+    return 1;
+  }
+  message.set((int16_t)21);
+  if(!node->write(message)){
+    fprintf(stderr, "Node cannot reach master on channel %d\n", CHANNELS_QUIET);
+    return 1;
+  }
+  printf("Master surveyed channels %d to %d and selected %d, node found it from %d in %lu ms\n",
+    CHANNEL_SCAN_MIN, CHANNEL_SCAN_MAX, CHANNELS_QUIET, WAVE_CHANNEL, (unsigned long)now);
+  return 0;
+}
+
+#endif
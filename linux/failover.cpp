@@ -0,0 +1,226 @@
+/**
+ * \file failover.cpp
+ * \brief Hot-standby master failover on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built as master (WAVE_STANDBY_ID), as standby (WAVE_STANDBY) and as node,
+ * see SCENARIO in the Makefile. FAILOVER_NODES nodes join, then:
+ *  - every heartbeat is lost for FAILOVER_HEARTBEAT_LOSS ms. Master is up
+ *    and answers probes, standby must not take over.
+ *  - master is powered off. Standby must take over within
+ *    FAILOVER_TAKEOVER ms, with the groups of master, and each node must
+ *    reach node 0 at its address, without joining again.
+ * Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-failover [-v]
+ *   -v  Print serial output of masters and nodes
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Nodes joining master, two per group */
+#define FAILOVER_NODES          4
+/** Delay in ms without any heartbeat reaching standby, master up */
+#define FAILOVER_HEARTBEAT_LOSS 20000
+/** Delay in ms after master loss for standby to be node 0 */
+#define FAILOVER_TAKEOVER       (STANDBY_TIMEOUT + (STANDBY_PROBES + 1) * STANDBY_PROBE_DELAY)
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+void masterPowerOff();
+bool masterIsPresent(uint8_t NID, uint8_t GID);
+
+/* Standby unit */
+void standbyBegin();
+void standbyListen();
+bool standbyIsStandby();
+bool standbyIsPresent(uint8_t NID, uint8_t GID);
+
+#if defined(WAVE_STANDBY)
+/***************************** Standby unit *********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void standbyBegin()
+{
+  wave.begin();
+}
+
+void standbyListen()
+{
+  wave.listen();
+}
+
+bool standbyIsStandby()
+{
+  return wave.isStandby();
+}
+
+bool standbyIsPresent(uint8_t NID, uint8_t GID)
+{
+  return wave.isPresent(NID, GID);
+}
+
+#elif defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+/* Freed at power off, which takes master off the air */
+static RF24 *radio;
+static RF24Network *network;
+static RF24Mesh *mesh;
+static RF24Wave *wave;
+
+void masterBegin()
+{
+  radio = new RF24(0, 0);
+  network = new RF24Network(*radio);
+  mesh = new RF24Mesh(*radio, *network);
+  wave = new RF24Wave(*radio, *network, *mesh);
+  wave->begin();
+}
+
+void masterListen()
+{
+  if(wave){
+    wave->listen();
+  }
+}
+
+void masterPowerOff()
+{
+  delete wave;
+  delete mesh;
+  delete network;
+  delete radio;
+  wave = NULL;
+}
+
+bool masterIsPresent(uint8_t NID, uint8_t GID)
+{
+  return wave && wave->isPresent(NID, GID);
+}
+
+#else
+/***************************** Node unit ************************************/
+
+static SimNode *nodes[FAILOVER_NODES];
+static int out;
+
+/* One ms of simulated time for masters and nodes */
+static void tick(uint32_t &now)
+{
+  uint8_t i;
+  simSetClock(++now);
+  masterListen();
+  standbyListen();
+  for(i=0; i<FAILOVER_NODES; i++){
+    nodes[i]->step();
+  }
+  Serial.flushTo(out);
+}
+
+/* Node sends a value to node 0, acked by whichever master has it */
+static bool reachMaster(SimNode *node)
+{
+  MyMessage message(1, V_TEMP);
+  if(!node->mesh.checkConnection()){
+    return false;
+  }
+  message.set((int16_t)21);
+  return node->write(message);
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i, GID;
+  uint32_t now = 1, start;
+  bool ok = true, present[FAILOVER_NODES];
+  int n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  standbyBegin();
+  memset(groups, 0, sizeof(groups));
+  for(i=0; i<FAILOVER_NODES; i++){
+    groups[0] = i / 2 + 1;
+    nodes[i] = new SimNode(i + 1, groups);
+  }
+  /* Joins, then heartbeats mirror the DHCP table one entry at a time */
+  while(now < 10000){
+    tick(now);
+  }
+  for(i=0; i<FAILOVER_NODES; i++){
+    if(!nodes[i]->wave.isSynchronized()){
+      fprintf(stderr, "Node %d not synchronized\n", i + 1);
+      return 1;
+    }
+  }
+
+  /* Heartbeat loss: master is up, standby has to keep waiting */
+  simSetTypeLoss(MASTER_HEARTBEAT_MSG_T, 100);
+  start = now;
+  while(now - start < FAILOVER_HEARTBEAT_LOSS && standbyIsStandby()){
+    tick(now);
+  }
+  simSetTypeLoss(MASTER_HEARTBEAT_MSG_T, 0);
+  if(!standbyIsStandby()){
+    fprintf(stderr, "Heartbeats lost: standby took over after %lu ms, master still up\n",
+      (unsigned long)(now - start));
+    return 1;
+  }
+  printf("Heartbeats lost %d ms: master answered probes, no takeover\n", FAILOVER_HEARTBEAT_LOSS);
+
+  /* Master loss: standby takes over with the same groups and addresses */
+  for(i=0; i<FAILOVER_NODES; i++){
+    GID = i / 2 + 1;
+    present[i] = masterIsPresent(i + 1, GID);
+  }
+  masterPowerOff();
+  start = now;
+  while(now - start < FAILOVER_TAKEOVER && standbyIsStandby()){
+    tick(now);
+  }
+  if(standbyIsStandby()){
+    fprintf(stderr, "Master lost: no takeover after %lu ms\n", (unsigned long)(now - start));
+    return 1;
+  }
+  printf("Master lost: standby took over after %lu ms\n", (unsigned long)(now - start));
+  for(i=0; i<FAILOVER_NODES; i++){
+    GID = i / 2 + 1;
+    if(!present[i] || !standbyIsPresent(i + 1, GID)){
+      fprintf(stderr, "Node %d missing from group %d\n", i + 1, GID);
+      ok = false;
+    }
+    if(!reachMaster(nodes[i])){
+      fprintf(stderr, "Node %d cannot reach new master\n", i + 1);
+      ok = false;
+    }
+    tick(now);
+  }
+  printf("%d nodes %s\n", FAILOVER_NODES, ok ? "reach new master, groups replicated" : "lost by failover");
+  return ok ? 0 : 1;
+}
+
+#endif
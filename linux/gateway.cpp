@@ -0,0 +1,323 @@
+/**
+ * \file gateway.cpp
+ * \brief Linux gateway for RF24Wave
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Runs RF24Wave in WAVE_MASTER mode inside an epoll loop which multiplexes
+ * the controller transport (stdin/stdout or a pseudo terminal), the radio
+ * polling timer and the print timer.
+ * With WAVE_GATEWAY_TCP, controllers connect over TCP instead; their sockets
+ * are serviced by RF24Wave on each radio tick and stdout only gets debug.
+ * With WAVE_CAPTURE, frames received from the radio and bytes received from
+ * a serial controller can be logged for rf24wave-replay.
+ *
+ * Usage: rf24wave-gateway [-p] [-o group:version:file] [-c file]
+ *   -p  Open a pseudo terminal for the controller and print its name
+ *   -o  Send firmware image file to all nodes of group
+ *   -c  Append capture records to file
+ *
+ */
+#include <RF24.h>
+#include <RF24Network.h>
+#include <RF24Mesh.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "RF24Wave.h"
+
+/**
+ * @def GATEWAY_CE_PIN
+ * @brief CE pin of the radio (GPIO 22 on Raspberry Pi)
+ */
+#ifndef GATEWAY_CE_PIN
+#define GATEWAY_CE_PIN 22
+#endif
+
+/**
+ * @def GATEWAY_CSN_PIN
+ * @brief CSN pin of the radio (CE0 on Raspberry Pi)
+ */
+#ifndef GATEWAY_CSN_PIN
+#define GATEWAY_CSN_PIN 0
+#endif
+
+/**
+ * @def RADIO_POLL_INTERVAL
+ * @brief Delay in us between two services of the radio
+ */
+#ifndef RADIO_POLL_INTERVAL
+#define RADIO_POLL_INTERVAL 1000
+#endif
+
+#define MAX_EVENTS 4
+
+RF24 radio(GATEWAY_CE_PIN, GATEWAY_CSN_PIN);
+RF24Network network(radio);
+RF24Mesh mesh(radio, network);
+RF24Wave wave(radio, network, mesh);
+
+static volatile sig_atomic_t running = 1;
+
+#if defined(WAVE_CAPTURE)
+static FILE *capture = NULL;
+
+static void writeCapture(const uint8_t *record, uint8_t length)
+{
+  fwrite(record, 1, length, capture);
+}
+
+/* Controller bytes are split in records of CAPTURE_PAYLOAD at most */
+static void captureController(const char *data, ssize_t length)
+{
+  uint8_t record[CAPTURE_HEADER_SIZE + CAPTURE_PAYLOAD];
+  ssize_t size;
+  while(capture && length > 0){
+    size = length < CAPTURE_PAYLOAD ? length : CAPTURE_PAYLOAD;
+    RF24Wave::captureHeader(record, millis(), 0, 255, CAPTURE_CONTROLLER_T, size);
+    memcpy(record + CAPTURE_HEADER_SIZE, data, size);
+    wave.captureRecord(record, CAPTURE_HEADER_SIZE + size);
+    data += size;
+    length -= size;
+  }
+}
+#endif
+
+#if defined(WAVE_OTA)
+static uint8_t *firmware = NULL;
+
+static bool readFirmware(uint16_t block, uint8_t *data)
+{
+  memcpy(data, firmware + (size_t)block * FIRMWARE_BLOCK_SIZE, FIRMWARE_BLOCK_SIZE);
+  return true;
+}
+
+/* Load image padded to a whole block and start its update */
+static bool startFirmware(const char *spec)
+{
+  unsigned group, version;
+  char path[256];
+  long size;
+  uint16_t blocks, crc = 0xFFFF;
+  size_t i;
+  FILE *file;
+  if(sscanf(spec, "%u:%u:%255s", &group, &version, path) != 3){
+    fprintf(stderr, "Bad firmware option: %s\n", spec);
+    return false;
+  }
+  file = fopen(path, "rb");
+  if(!file || fseek(file, 0, SEEK_END) < 0 || (size = ftell(file)) <= 0){
+    perror(path);
+    return false;
+  }
+  blocks = (size + FIRMWARE_BLOCK_SIZE - 1) / FIRMWARE_BLOCK_SIZE;
+  firmware = (uint8_t *)malloc((size_t)blocks * FIRMWARE_BLOCK_SIZE);
+  memset(firmware, 0xFF, (size_t)blocks * FIRMWARE_BLOCK_SIZE);
+  rewind(file);
+  if(fread(firmware, 1, size, file) != (size_t)size){
+    perror(path);
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+  for(i=0; i<(size_t)blocks * FIRMWARE_BLOCK_SIZE; i++){
+    crc = RF24Wave::crc16Update(crc, firmware[i]);
+  }
+  return wave.otaStart(group, version, blocks, crc, readFirmware);
+}
+#endif
+
+static void stop(int sig)
+{
+  (void)sig;
+  running = 0;
+}
+
+static bool setNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static int openPty()
+{
+  struct termios tio;
+  int slave;
+  int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if(fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0){
+    perror("pty");
+    return -1;
+  }
+  /* Slave end is kept open so master does not hang up between controllers */
+  slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+  if(slave < 0 || tcgetattr(slave, &tio) < 0){
+    perror("pty");
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  fprintf(stderr, "Controller pty: %s\n", ptsname(fd));
+  return fd;
+}
+
+static int createTimer(uint32_t intervalUs)
+{
+  struct itimerspec spec;
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if(fd < 0){
+    return -1;
+  }
+  spec.it_interval.tv_sec = intervalUs / 1000000;
+  spec.it_interval.tv_nsec = (intervalUs % 1000000) * 1000;
+  spec.it_value = spec.it_interval;
+  timerfd_settime(fd, 0, &spec, NULL);
+  return fd;
+}
+
+static bool watch(int epfd, int op, int fd, uint32_t events)
+{
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  return epoll_ctl(epfd, op, fd, &ev) == 0;
+}
+
+int main(int argc, char **argv)
+{
+  struct epoll_event events[MAX_EVENTS];
+  char buffer[256];
+  uint64_t expirations;
+  ssize_t length;
+  int epfd, ctrlIn, ctrlOut, radioTimer, printTimer, n, i;
+  const char *firmwareSpec = NULL;
+  const char *capturePath = NULL;
+  bool writing = false;
+
+  ctrlIn = STDIN_FILENO;
+  ctrlOut = STDOUT_FILENO;
+  while((n = getopt(argc, argv, "po:c:")) != -1){
+    if(n == 'p'){
+      ctrlIn = ctrlOut = openPty();
+      if(ctrlIn < 0){
+        return 1;
+      }
+    }else if(n == 'o'){
+      firmwareSpec = optarg;
+    }else if(n == 'c'){
+      capturePath = optarg;
+    }else{
+      fprintf(stderr, "Usage: %s [-p] [-o group:version:file] [-c file]\n", argv[0]);
+      return 1;
+    }
+  }
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  signal(SIGPIPE, SIG_IGN);
+
+  epfd = epoll_create1(0);
+  radioTimer = createTimer(RADIO_POLL_INTERVAL);
+  printTimer = createTimer(PRINT_DELAY * 1000UL);
+#if !defined(WAVE_GATEWAY_TCP)
+  if(!setNonBlocking(ctrlIn) || !watch(epfd, EPOLL_CTL_ADD, ctrlIn, EPOLLIN)){
+    perror("controller");
+    return 1;
+  }
+#endif
+  if(epfd < 0 || radioTimer < 0 || printTimer < 0 || !setNonBlocking(ctrlOut)
+      || !watch(epfd, EPOLL_CTL_ADD, radioTimer, EPOLLIN)
+      || !watch(epfd, EPOLL_CTL_ADD, printTimer, EPOLLIN)){
+    perror("epoll");
+    return 1;
+  }
+
+#if defined(WAVE_CAPTURE)
+  if(capturePath){
+    capture = fopen(capturePath, "ab");
+    if(!capture){
+      perror(capturePath);
+      return 1;
+    }
+    wave.setCaptureSink(writeCapture);
+  }
+#else
+  (void)capturePath;
+#endif
+
+  Serial.begin(115200);
+  wave.begin();
+#if defined(WAVE_OTA)
+  if(firmwareSpec && !startFirmware(firmwareSpec)){
+    return 1;
+  }
+#else
+  (void)firmwareSpec;
+#endif
+
+  while(running){
+    n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+    if(n < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      perror("epoll_wait");
+      break;
+    }
+    for(i=0; i<n; i++){
+      if(events[i].data.fd == radioTimer || events[i].data.fd == printTimer){
+        if(read(events[i].data.fd, &expirations, sizeof(expirations)) < 0){
+          continue;
+        }
+        if(events[i].data.fd == printTimer){
+          F_DEBUG(wave.printNetwork())
+        }
+      }else if(events[i].data.fd == ctrlIn && (events[i].events & (EPOLLIN | EPOLLHUP))){
+        length = read(ctrlIn, buffer, sizeof(buffer));
+        if(length > 0){
+#if defined(WAVE_CAPTURE)
+          captureController(buffer, length);
+#endif
+          Serial.feed(buffer, length);
+        }else if(length == 0 && ctrlIn == STDIN_FILENO){
+          running = 0;
+        }
+      }
+    }
+    /* One pass for radio, then one per line received from controller */
+    do{
+      wave.listen();
+    }while(Serial.available());
+
+    /* Controller output is written only when the descriptor accepts it */
+    if(Serial.pending() && Serial.flushTo(ctrlOut) < 0){
+      perror("controller");
+      break;
+    }
+    if(Serial.pending() != writing){
+      writing = Serial.pending();
+      if(ctrlOut == ctrlIn){
+        watch(epfd, EPOLL_CTL_MOD, ctrlOut, EPOLLIN | (writing ? EPOLLOUT : 0));
+      }else{
+        watch(epfd, writing ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, ctrlOut, EPOLLOUT);
+      }
+    }
+  }
+  Serial.flushTo(ctrlOut);
+#if defined(WAVE_CAPTURE)
+  if(capture){
+    fprintf(stderr, "Captured %lu records\n", (unsigned long)wave.captureStats().captured);
+    fclose(capture);
+  }
+#endif
+  close(radioTimer);
+  close(printTimer);
+  close(epfd);
+  return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * \file handlers.cpp
+ * \brief Sensor handler table of a node on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master (WAVE_SERIAL_RECEIVE) and once as node, see
+ * SCENARIO in the Makefile. A node with a handler table joins, then the
+ * controller sends it one command after another. Each command must reach
+ * the handler of the first matching route with its value, or be dropped
+ * when no route matches. receive() must never be called while a table is
+ * set. Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-handlers [-v]
+ *   -v  Print serial output of master and node
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Node of the scenario */
+#define HANDLERS_NID            1
+/** Delay in ms of simulated time for a command to reach the node */
+#define HANDLERS_TIMEOUT        200
+/** Route of a command dropped by the node */
+#define HANDLERS_DROPPED        0xFF
+/** Route of a command given to receive() */
+#define HANDLERS_RECEIVE        0xFE
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+#else
+/***************************** Node unit ************************************/
+
+typedef struct{
+  const char *line;
+  /* Route expected to get it, HANDLERS_DROPPED if none */
+  uint8_t route;
+  /* Value handler gets, hex of the bytes for C_STREAM */
+  const char *value;
+}handlers_case_t;
+
+static void onSwitch(const MyMessage &message);
+static void onChild2(const MyMessage &message);
+static void onStream(const MyMessage &message);
+
+static constexpr sensor_route_t routes[] = {
+  {1, V_STATUS, C_SET, onSwitch},
+  {2, WAVE_ANY, WAVE_ANY, onChild2},
+  {3, V_VAR1, C_STREAM, onStream},
+};
+
+static const handlers_case_t cases[] = {
+  {"1;1;1;0;2;1\n", 0, "1"},
+  {"1;1;2;0;2;\n", HANDLERS_DROPPED, ""},
+  {"1;3;1;0;2;1\n", HANDLERS_DROPPED, ""},
+  {"1;2;1;0;38;12.5\n", 1, "12.5"},
+  {"1;2;2;0;2;\n", 1, ""},
+  {"1;3;4;0;24;0A0B\n", 2, "0A0B"},
+  {"1;4;4;0;24;ZZZZ\n", HANDLERS_DROPPED, ""},
+};
+
+static SimNode *node;
+static uint8_t handled = HANDLERS_DROPPED;
+static uint8_t calls;
+static char value[MAX_PAYLOAD * 2 + 1];
+static uint32_t now = 1;
+static int out;
+
+/* Called without a handler table only */
+void receive(const MyMessage &message)
+{
+  handled = HANDLERS_RECEIVE;
+  calls++;
+}
+
+static void record(uint8_t route, const MyMessage &message)
+{
+  handled = route;
+  calls++;
+  message.getString(value);
+}
+
+static void onSwitch(const MyMessage &message)
+{
+  record(0, message);
+}
+
+static void onChild2(const MyMessage &message)
+{
+  record(1, message);
+}
+
+static void onStream(const MyMessage &message)
+{
+  record(2, message);
+}
+
+/* One ms of simulated time for master and node */
+static void tick()
+{
+  simSetClock(++now);
+  masterListen();
+  node->step();
+  Serial.flushTo(out);
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i, dropped = 0;
+  uint32_t start;
+  bool ok = true;
+  int n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(HANDLERS_NID, groups);
+  node->wave.setHandlers(routes);
+  while(now < 5000){
+    tick();
+  }
+  if(!node->wave.isSynchronized()){
+    fprintf(stderr, "Node not synchronized\n");
+    return 1;
+  }
+
+  for(i=0; i<sizeof(cases)/sizeof(cases[0]); i++){
+    handled = HANDLERS_DROPPED;
+    calls = 0;
+    value[0] = 0;
+    Serial.feed(cases[i].line, strlen(cases[i].line));
+    start = now;
+    while(now - start < HANDLERS_TIMEOUT){
+      tick();
+    }
+    if(calls > 1 || handled != cases[i].route
+        || (handled < HANDLERS_RECEIVE && strcmp(value, cases[i].value) != 0)){
+      fprintf(stderr, "%.*s: route %d with \"%s\", expected route %d with \"%s\"\n",
+        (int)strlen(cases[i].line) - 1, cases[i].line, handled, value, cases[i].route, cases[i].value);
+      ok = false;
+    }
+    if(cases[i].route == HANDLERS_DROPPED){
+      dropped++;
+    }
+  }
+  printf("%d commands %s, %d dropped without a route\n", (int)(sizeof(cases)/sizeof(cases[0])),
+    ok ? "reach their route" : "misrouted", dropped);
+  return ok ? 0 : 1;
+}
+
+#endif
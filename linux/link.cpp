@@ -0,0 +1,179 @@
+/**
+ * \file link.cpp
+ * \brief PA level and retries adapted to path loss on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master (WAVE_LINK_QUALITY, WAVE_SERIAL_RECEIVE) and once as
+ * node (WAVE_LINK_QUALITY), both adapting every LINK_ADAPT_DELAY ms, see
+ * SCENARIO in the Makefile. A node joins master, sends a value and gets a
+ * command every LINK_TRAFFIC_DELAY ms, for LINK_PHASE ms at each path loss:
+ *  - without path loss, both must go down to LINK_PA_MIN and LINK_RETRY_MIN.
+ *  - with full path loss at PA min, the node must raise its PA and deliver
+ *    at least LINK_DELIVERY_MIN percent of its values in the last period.
+ *  - without path loss again, the node must go back down to LINK_PA_MIN.
+ * Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-link [-v]
+ *   -v  Print serial output of master and node
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Delay in ms between two values of the node, and two commands of master */
+#define LINK_TRAFFIC_DELAY      50
+/** Delay in ms of simulated time at each path loss */
+#define LINK_PHASE              (12 * (uint32_t)LINK_ADAPT_DELAY)
+/** Percent of values node must deliver in the last period of a phase */
+#define LINK_DELIVERY_MIN       90
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+uint8_t masterPALevel();
+uint8_t masterRetries();
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+uint8_t masterPALevel()
+{
+  return wave.linkPALevel();
+}
+
+uint8_t masterRetries()
+{
+  return wave.linkRetries();
+}
+
+#else
+/***************************** Node unit ************************************/
+
+static SimNode *node;
+static uint32_t now = 1;
+static int out;
+
+/* Commands of master, as dispatched by the node */
+void receive(const MyMessage &message)
+{
+  (void)message;
+}
+
+/* Traffic both ways at path loss for LINK_PHASE ms, values of the node
+ * sent and delivered in the last adaptation period */
+static void phase(uint8_t loss, uint32_t &sent, uint32_t &delivered)
+{
+  MyMessage message(1, V_TEMP);
+  char command[MY_GATEWAY_MAX_SEND_LENGTH];
+  uint8_t commandLength;
+  uint32_t start = now;
+
+  commandLength = snprintf(command, sizeof(command), "1;1;%d;0;%d;1\n", C_SET, V_STATUS);
+  simSetPathLoss(loss);
+  sent = delivered = 0;
+  while(now - start < LINK_PHASE){
+    simSetClock(++now);
+    if(now % LINK_TRAFFIC_DELAY == 0 && node->wave.isSynchronized()){
+      message.set((int16_t)(now / LINK_TRAFFIC_DELAY % 100));
+      if(now - start >= LINK_PHASE - LINK_ADAPT_DELAY){
+        sent++;
+        if(node->write(message)){
+          delivered++;
+        }
+      }else{
+        node->write(message);
+      }
+      Serial.feed(command, commandLength);
+    }
+    masterListen();
+    node->step();
+    Serial.flushTo(out);
+  }
+  printf("  loss %3u%%  node PA %u retries %2u  master PA %u retries %2u  delivered %lu/%lu\n",
+    loss, node->wave.linkPALevel(), node->wave.linkRetries(), masterPALevel(), masterRetries(),
+    (unsigned long)delivered, (unsigned long)sent);
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t groups[MAX_GROUPS];
+  uint32_t sent, delivered;
+  bool ok = true;
+  int n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(1, groups);
+  while(now < 5000){
+    simSetClock(++now);
+    masterListen();
+    node->step();
+    Serial.flushTo(out);
+  }
+  if(!node->wave.isSynchronized()){
+    fprintf(stderr, "Node not synchronized\n");
+    return 1;
+  }
+
+  printf("Adaptation every %d ms, %d s per path loss, traffic every %d ms both ways\n",
+    LINK_ADAPT_DELAY, LINK_PHASE / 1000, LINK_TRAFFIC_DELAY);
+  /* Clean link: power and retries down to their minimum */
+  phase(0, sent, delivered);
+  if(node->wave.linkPALevel() != LINK_PA_MIN || node->wave.linkRetries() != LINK_RETRY_MIN
+      || masterPALevel() != LINK_PA_MIN || masterRetries() != LINK_RETRY_MIN){
+    fprintf(stderr, "Clean link: not down to PA %d and %d retries\n", LINK_PA_MIN, LINK_RETRY_MIN);
+    ok = false;
+  }
+  /* Every attempt lost at PA min: power up until values go through */
+  phase(100, sent, delivered);
+  if(node->wave.linkPALevel() == LINK_PA_MIN){
+    fprintf(stderr, "Full path loss: node PA not raised\n");
+    ok = false;
+  }
+  if(sent == 0 || delivered * 100 < (uint32_t)LINK_DELIVERY_MIN * sent){
+    fprintf(stderr, "Full path loss: %lu/%lu values delivered\n", (unsigned long)delivered, (unsigned long)sent);
+    ok = false;
+  }
+  /* Clean link again: power back down */
+  phase(0, sent, delivered);
+  if(node->wave.linkPALevel() != LINK_PA_MIN){
+    fprintf(stderr, "Clean link again: node PA %d, not back to %d\n", node->wave.linkPALevel(), LINK_PA_MIN);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,244 @@
+/**
+ * \file liveness.cpp
+ * \brief Leave and eviction of group members on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master (WAVE_LIVENESS, WAVE_SERIAL_RECEIVE, WAVE_SNAPSHOT)
+ * and once as node (WAVE_LIVENESS), see SCENARIO in the Makefile.
+ * LIVENESS_NODES nodes join group 1, then:
+ *  - controller sends a command to group 1 and the member it reaches first
+ *    leaves before the others got it. Master and remaining members must
+ *    drop it, and each remaining member must get the command once.
+ *  - another member goes silent after a last value. Its snapshot must give
+ *    the seconds since that value. Master must evict it after
+ *    LIVE_EVICT_PERIODS checks, not before, and keep members answering
+ *    its heartbeat requests.
+ * Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-liveness [-v]
+ *   -v  Print serial output of master and nodes
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Nodes joining group 1, at most MAX_NODE_GROUPS */
+#define LIVENESS_NODES          4
+/** Delay in ms for a command to reach every remaining member */
+#define LIVENESS_FANOUT         1000
+/** Delay in ms of silence after which snapshot of silent node is checked */
+#define LIVENESS_SEEN           42500
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+bool masterIsPresent(uint8_t NID, uint8_t GID);
+uint16_t masterSeen(uint8_t NID);
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+bool masterIsPresent(uint8_t NID, uint8_t GID)
+{
+  return wave.isPresent(NID, GID);
+}
+
+uint16_t masterSeen(uint8_t NID)
+{
+  snapshot_node_t node;
+  uint8_t i;
+  for(i=0; wave.snapshotNode(i, node); i++){
+    if(node.nodeID == NID){
+      return node.seen;
+    }
+  }
+  return 0xFFFF;
+}
+
+#else
+/***************************** Node unit ************************************/
+
+static SimNode *nodes[LIVENESS_NODES];
+/* Nodes left or silent are not stepped anymore, else they would join again */
+static bool stopped[LIVENESS_NODES];
+static uint8_t received[LIVENESS_NODES];
+static uint8_t current;
+static uint32_t now = 1;
+static int out;
+
+/* Commands dispatched by the node being stepped */
+void receive(const MyMessage &message)
+{
+  received[current]++;
+}
+
+/* One ms of simulated time for master and nodes */
+static void tick()
+{
+  simSetClock(++now);
+  masterListen();
+  for(current=0; current<LIVENESS_NODES; current++){
+    if(!stopped[current]){
+      nodes[current]->step();
+    }
+  }
+  Serial.flushTo(out);
+}
+
+/* Master and members still in group 1 agree that NID is gone */
+static bool checkGone(uint8_t NID)
+{
+  uint8_t i;
+  bool ok = true;
+  if(masterIsPresent(NID, 1)){
+    fprintf(stderr, "Node %d still in group 1 of master\n", NID);
+    ok = false;
+  }
+  for(i=0; i<LIVENESS_NODES; i++){
+    if(!stopped[i] && nodes[i]->wave.isPresent(NID, 1)){
+      fprintf(stderr, "Node %d still knows node %d in group 1\n", i + 1, NID);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i, left = LIVENESS_NODES, silent = LIVENESS_NODES;
+  uint32_t start;
+  uint16_t seen = 0xFFFF;
+  bool ok = true;
+  MyMessage message(1, V_TEMP);
+  const char command[] = "201;0;1;0;2;1\n";
+  int n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  for(i=0; i<LIVENESS_NODES; i++){
+    nodes[i] = new SimNode(i + 1, groups);
+  }
+  while(now < 10000){
+    tick();
+  }
+  for(i=0; i<LIVENESS_NODES; i++){
+    if(!nodes[i]->wave.isSynchronized() || !masterIsPresent(i + 1, 1)){
+      fprintf(stderr, "Node %d not synchronized\n", i + 1);
+      return 1;
+    }
+  }
+
+  /* Leave: first member reached by the command leaves, nodes not stepped */
+  Serial.feed(command, strlen(command));
+  for(n=0; n<10 && left == LIVENESS_NODES; n++){
+    simSetClock(++now);
+    masterListen();
+    for(i=0; i<LIVENESS_NODES && !nodes[i]->network.available(); i++);
+    left = i;
+  }
+  if(left == LIVENESS_NODES){
+    fprintf(stderr, "Group command reached no member\n");
+    return 1;
+  }
+  nodes[left]->wave.leave();
+  stopped[left] = true;
+  start = now;
+  while(now - start < LIVENESS_FANOUT){
+    tick();
+  }
+  for(i=0; i<LIVENESS_NODES; i++){
+    if(!stopped[i] && received[i] != 1){
+      fprintf(stderr, "Node %d got the group command %d times\n", i + 1, received[i]);
+      ok = false;
+    }
+  }
+  ok = checkGone(left + 1) && ok;
+  if(!ok){
+    return 1;
+  }
+  printf("Node %d left during fan-out, %d members got the command once\n", left + 1, LIVENESS_NODES - 1);
+
+  /* Eviction: a member goes silent after a last value, the others answer
+   * heartbeat requests */
+  silent = (left + 1) % LIVENESS_NODES;
+  message.set((int16_t)21);
+  if(!nodes[silent]->write(message)){
+    fprintf(stderr, "Node %d cannot reach master\n", silent + 1);
+    return 1;
+  }
+  stopped[silent] = true;
+  start = now;
+  while(now - start < (LIVE_EVICT_PERIODS + 2) * (uint32_t)LIVE_CHECK_DELAY && masterIsPresent(silent + 1, 1)){
+    tick();
+    if(now - start == LIVENESS_SEEN){
+      seen = masterSeen(silent + 1);
+    }
+  }
+  /* Stamped in seconds of master clock, so within one second */
+  if(seen < LIVENESS_SEEN / 1000 || seen > LIVENESS_SEEN / 1000 + 1){
+    fprintf(stderr, "Node %d silent for %d ms, snapshot gives %d s\n", silent + 1, LIVENESS_SEEN, seen);
+    return 1;
+  }
+  if(masterIsPresent(silent + 1, 1)){
+    fprintf(stderr, "Node %d silent for %lu ms, not evicted\n", silent + 1, (unsigned long)(now - start));
+    return 1;
+  }
+  if(now - start < (LIVE_EVICT_PERIODS - 1) * (uint32_t)LIVE_CHECK_DELAY){
+    fprintf(stderr, "Node %d evicted after %lu ms only\n", silent + 1, (unsigned long)(now - start));
+    return 1;
+  }
+  /* Leave frames of master reach the members */
+  start = now;
+  while(now - start < LIVENESS_FANOUT){
+    tick();
+  }
+  ok = checkGone(silent + 1);
+  for(i=0; i<LIVENESS_NODES; i++){
+    if(!stopped[i] && !masterIsPresent(i + 1, 1)){
+      fprintf(stderr, "Node %d answered heartbeats, evicted anyway\n", i + 1);
+      ok = false;
+    }
+  }
+  if(!ok){
+    return 1;
+  }
+  printf("Silent node %d seen %d s ago after %d ms, evicted, %d members kept\n",
+    silent + 1, seen, LIVENESS_SEEN, LIVENESS_NODES - 2);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ * \file loopback.cpp
+ * \brief TCP controller transport of a master on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as a TCP master and once as node, see SCENARIO in the Makefile.
+ * Controllers are sockets of this process, connected to the master over
+ * loopback on LOOPBACK_PORT. A node joins, then:
+ *  - MY_GATEWAY_MAX_CLIENTS controllers connect and get the startup line,
+ *    one more is closed by master.
+ *  - a value of the node reaches every controller.
+ *  - commands cut in two by one controller, with a whole command of
+ *    another one in between, reach the node as sent.
+ *  - a controller leaves and its slot is given to a new one.
+ * Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-loopback [-v]
+ *   -v  Print serial output of master and node
+ *
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Port of master, apart from the one of a gateway running on this host */
+#define LOOPBACK_PORT           15003
+/** Controllers master serves, MY_GATEWAY_MAX_CLIENTS of master unit */
+#define LOOPBACK_CLIENTS        4
+/** Delay in ms of simulated time for an answer */
+#define LOOPBACK_TIMEOUT        2000
+/** Node of the scenario */
+#define LOOPBACK_NID            1
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+#else
+/***************************** Node unit ************************************/
+
+typedef struct{
+  int fd;
+  char line[MY_GATEWAY_MAX_SEND_LENGTH];
+  uint8_t length;
+}loopback_client_t;
+
+static SimNode *node;
+static loopback_client_t clients[LOOPBACK_CLIENTS + 1];
+static MyMessage received[2];
+static uint8_t receivedCount;
+static uint32_t now = 1;
+static int out;
+
+/* Commands of controllers, as dispatched by the node */
+void receive(const MyMessage &message)
+{
+  if(receivedCount < 2){
+    memcpy(&received[receivedCount], &message, sizeof(MyMessage));
+  }
+  receivedCount++;
+}
+
+/* One ms of simulated time for master and node */
+static void tick()
+{
+  simSetClock(++now);
+  masterListen();
+  node->step();
+  Serial.flushTo(out);
+}
+
+static bool clientConnect(loopback_client_t &client)
+{
+  struct sockaddr_in addr;
+  memset(&client, 0, sizeof(loopback_client_t));
+  client.fd = socket(AF_INET, SOCK_STREAM, 0);
+  if(client.fd < 0){
+    perror("socket");
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(LOOPBACK_PORT);
+  if(connect(client.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    perror("connect");
+    return false;
+  }
+  fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+static void clientSend(loopback_client_t &client, const char *data)
+{
+  if(send(client.fd, data, strlen(data), MSG_NOSIGNAL) != (ssize_t)strlen(data)){
+    perror("send");
+  }
+}
+
+/* Next line sent by master, NULL if closed or none within LOOPBACK_TIMEOUT */
+static const char *clientLine(loopback_client_t &client)
+{
+  uint32_t start = now;
+  ssize_t length;
+  char c;
+  client.length = 0;
+  while(now - start < LOOPBACK_TIMEOUT){
+    length = recv(client.fd, &c, 1, 0);
+    if(length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+      return NULL;
+    }
+    if(length < 0){
+      tick();
+      continue;
+    }
+    if(c == '\n'){
+      client.line[client.length] = 0;
+      return client.line;
+    }
+    if(client.length < MY_GATEWAY_MAX_SEND_LENGTH - 1){
+      client.line[client.length++] = c;
+    }
+  }
+  return NULL;
+}
+
+/* Master has closed the client within LOOPBACK_TIMEOUT */
+static bool clientClosed(loopback_client_t &client)
+{
+  uint32_t start = now;
+  ssize_t length;
+  char c;
+  while(now - start < LOOPBACK_TIMEOUT){
+    length = recv(client.fd, &c, 1, 0);
+    if(length == 0){
+      return true;
+    }
+    if(length < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+      return true;
+    }
+    tick();
+  }
+  return false;
+}
+
+static bool expectLine(uint8_t i, const char *expected)
+{
+  const char *line = clientLine(clients[i]);
+  if(!line || strcmp(line, expected)){
+    fprintf(stderr, "Controller %d: got \"%s\", not \"%s\"\n", i, line ? line : "(none)", expected);
+    return false;
+  }
+  return true;
+}
+
+static bool expectReceived(uint8_t i, uint8_t sensor, uint8_t value)
+{
+  if(received[i].sensor != sensor || mGetCommand(received[i]) != C_SET
+      || received[i].type != V_STATUS || received[i].getByte() != value){
+    fprintf(stderr, "Command %d: sensor %d got %d, not sensor %d value %d\n", i,
+      received[i].sensor, received[i].getByte(), sensor, value);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  char ready[MY_GATEWAY_MAX_SEND_LENGTH];
+  char value[MY_GATEWAY_MAX_SEND_LENGTH];
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i;
+  uint32_t start;
+  MyMessage message(1, V_TEMP);
+  bool ok = true;
+  int n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(LOOPBACK_NID, groups);
+  while(!node->step() && now < 10000){
+    tick();
+  }
+  if(!node->wave.isSynchronized()){
+    fprintf(stderr, "Node %d not synchronized\n", LOOPBACK_NID);
+    return 1;
+  }
+
+  /* Every slot gets the startup line, the extra client is closed */
+  snprintf(ready, sizeof(ready), "%d;255;%d;0;%d;%s", GATEWAY_ADDRESS, C_INTERNAL,
+    I_GATEWAY_READY, MSG_GW_STARTUP_COMPLETE);
+  for(i=0; i<=LOOPBACK_CLIENTS; i++){
+    if(!clientConnect(clients[i])){
+      return 1;
+    }
+  }
+  for(i=0; i<LOOPBACK_CLIENTS; i++){
+    ok &= expectLine(i, ready);
+  }
+  if(!clientClosed(clients[LOOPBACK_CLIENTS])){
+    fprintf(stderr, "Controller %d over MY_GATEWAY_MAX_CLIENTS not closed\n", LOOPBACK_CLIENTS);
+    ok = false;
+  }
+  close(clients[LOOPBACK_CLIENTS].fd);
+  if(!ok){
+    return 1;
+  }
+  printf("%d controllers ready, one more closed\n", LOOPBACK_CLIENTS);
+
+  /* Value of node goes to all controllers */
+  message.set((int16_t)21);
+  if(!node->write(message)){
+    fprintf(stderr, "Node %d cannot reach master\n", LOOPBACK_NID);
+    return 1;
+  }
+  snprintf(value, sizeof(value), "%d;1;%d;0;%d;21", LOOPBACK_NID, C_SET, V_TEMP);
+  for(i=0; i<LOOPBACK_CLIENTS; i++){
+    ok &= expectLine(i, value);
+  }
+  if(!ok){
+    return 1;
+  }
+  printf("Value of node %d read by %d controllers\n", LOOPBACK_NID, LOOPBACK_CLIENTS);
+
+  /* Halves of one command around a whole command of another controller */
+  clientSend(clients[0], "1;1;1;0;2;");
+  for(n=0; n<10; n++){
+    tick();
+  }
+  clientSend(clients[1], "1;2;1;0;2;0\n");
+  for(n=0; n<10; n++){
+    tick();
+  }
+  clientSend(clients[0], "1\n");
+  start = now;
+  while(receivedCount < 2 && now - start < LOOPBACK_TIMEOUT){
+    tick();
+  }
+  if(receivedCount != 2){
+    fprintf(stderr, "Node %d got %d commands, not 2\n", LOOPBACK_NID, receivedCount);
+    return 1;
+  }
+  if(!expectReceived(0, 2, 0) || !expectReceived(1, 1, 1)){
+    return 1;
+  }
+  printf("Commands of 2 controllers reach node %d whole\n", LOOPBACK_NID);
+
+  /* Slot of a controller gone is given to the next one */
+  close(clients[2].fd);
+  for(n=0; n<10; n++){
+    tick();
+  }
+  if(!clientConnect(clients[2]) || !expectLine(2, ready)){
+    return 1;
+  }
+  printf("Slot of a closed controller reused\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * \file present.cpp
+ * \brief Batched presentation of a node on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master and once as node, both with WAVE_PRESENT_BATCH, see
+ * SCENARIO in the Makefile. A node joins and presents itself while every
+ * presentation frame is lost for PRESENT_LOSS ms: the batch must be kept
+ * and retried by listen(). Once frames go through again, the controller
+ * must get each presentation line once. Exits with 1 otherwise.
+ *
+ * Usage: rf24wave-present [-v]
+ *   -v  Print serial output of master and node
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Node of the scenario */
+#define PRESENT_NID             1
+/** Delay in ms every presentation frame is lost */
+#define PRESENT_LOSS            5000
+/** Delay in ms for the batch to be sent once frames go through */
+#define PRESENT_SETTLE          (((uint32_t)PRESENT_RETRY_DELAY << PRESENT_RETRY_SHIFT) + 1000)
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+#else
+/***************************** Node unit ************************************/
+
+/* Lines controller must get once, node 1 */
+static const char *lines[] = {
+  "1;255;0;0;17;\n",
+  "1;255;3;0;11;Present\n",
+  "1;255;3;0;12;1.0\n",
+  "1;1;0;0;3;Light\n",
+};
+
+static SimNode *node;
+static uint32_t now = 1;
+static int out;
+
+/* One ms of simulated time for master and node */
+static void tick()
+{
+  simSetClock(++now);
+  masterListen();
+  node->step();
+  Serial.flushTo(out);
+}
+
+/* Occurrences of line in serial output so far */
+static int countLine(const char *line)
+{
+  char text[16384];
+  const char *found;
+  ssize_t size;
+  int count = 0;
+  size = pread(out, text, sizeof(text) - 1, 0);
+  if(size < 0){
+    return -1;
+  }
+  text[size] = 0;
+  for(found = strstr(text, line); found; found = strstr(found + 1, line)){
+    count++;
+  }
+  return count;
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i;
+  uint32_t start;
+  bool ok = true, verbose = false;
+  char path[] = "/tmp/rf24wave-present-XXXXXX";
+  char text[256];
+  ssize_t size;
+  int n;
+
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      verbose = true;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+  /* Serial output is kept to look for the lines of controller */
+  out = mkstemp(path);
+  if(out < 0){
+    perror("mkstemp");
+    return 1;
+  }
+  unlink(path);
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(PRESENT_NID, groups);
+  while(now < 5000){
+    tick();
+  }
+  if(!node->wave.isSynchronized()){
+    fprintf(stderr, "Node not synchronized\n");
+    return 1;
+  }
+
+  simSetTypeLoss(PRESENT_MSG_T, 100);
+  node->wave.sendSketchInfo("Present", "1.0");
+  node->wave.present(1, S_BINARY, "Light");
+  start = now;
+  while(now - start < PRESENT_LOSS){
+    tick();
+  }
+  for(i=0; i<sizeof(lines)/sizeof(lines[0]); i++){
+    if(countLine(lines[i]) != 0){
+      fprintf(stderr, "Presentation reached controller while frames were lost\n");
+      ok = false;
+      break;
+    }
+  }
+  simSetTypeLoss(PRESENT_MSG_T, 0);
+  start = now;
+  while(now - start < PRESENT_SETTLE){
+    tick();
+  }
+  for(i=0; i<sizeof(lines)/sizeof(lines[0]); i++){
+    n = countLine(lines[i]);
+    if(n != 1){
+      fprintf(stderr, "%.*s: %d times\n", (int)strlen(lines[i]) - 1, lines[i], n);
+      ok = false;
+    }
+  }
+  if(verbose){
+    for(start=0; (size = pread(out, text, sizeof(text), start)) > 0; start += size){
+      fwrite(text, 1, size, stdout);
+    }
+  }
+  printf("Presentation lost %d ms, %s\n", PRESENT_LOSS,
+    ok ? "kept and sent once frames went through" : "not delivered once");
+  return ok ? 0 : 1;
+}
+
+#endif
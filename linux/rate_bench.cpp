@@ -0,0 +1,230 @@
+/**
+ * \file rate_bench.cpp
+ * \brief Goodput of each data rate and of rate adaptation, on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master and once as node with WAVE_RATE_ADAPT, see SCENARIO
+ * in the Makefile. Goodput is payload bits over the air time the sim
+ * counts, retries included.
+ *
+ * First, two bare meshes apart from the network send BENCH_WRITES frames
+ * of BENCH_PAYLOAD bytes at each data rate and path loss, PA min and 15
+ * retries. Then a node joins master, sends a value and gets a command
+ * every BENCH_TRAFFIC_DELAY ms, and master adapts the network rate for
+ * BENCH_PHASE ms at each path loss. Exits with 1 if the node does not end
+ * a phase at the rate of master.
+ *
+ * Usage: rf24wave-rate-bench [-v]
+ *   -v  Print serial output of master and node
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Frames sent at each data rate and path loss by the bare meshes */
+#define BENCH_WRITES            2000
+/** Payload of frames sent by the bare meshes */
+#define BENCH_PAYLOAD           24
+/** Channel of the bare meshes, away from WAVE_CHANNEL */
+#define BENCH_CHANNEL           90
+/** Delay in ms between two values of the node, and two commands of master */
+#define BENCH_TRAFFIC_DELAY     50
+/** Delay in ms of simulated time at each path loss */
+#define BENCH_PHASE             (6 * RATE_ADAPT_DELAY)
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+uint8_t masterRateLevel();
+uint8_t masterPALevel();
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+uint8_t masterRateLevel()
+{
+  return wave.dataRateLevel();
+}
+
+uint8_t masterPALevel()
+{
+  return wave.linkPALevel();
+}
+
+#else
+/***************************** Node unit ************************************/
+
+static const rf24_datarate_e rates[] = {RF24_250KBPS, RF24_1MBPS, RF24_2MBPS};
+static const char *rateNames[] = {"250K", "1M", "2M"};
+static const uint8_t losses[] = {0, 10, 20, 40};
+static uint32_t commands;
+
+/* Commands of master, as dispatched by the node */
+void receive(const MyMessage &message)
+{
+  (void)message;
+  commands++;
+}
+
+/* kbit/s of payload over the air used since airStart */
+static uint32_t goodput(uint32_t bytes, uint32_t airStart)
+{
+  uint32_t air = simAirtime() - airStart;
+  return air ? (uint64_t)bytes * 8 * 1000 / air : 0;
+}
+
+/* Each data rate with PA and retries fixed, no adaptation */
+static void benchRates()
+{
+  RF24 masterRadio(0, 0), nodeRadio(0, 0);
+  RF24Network masterNetwork(masterRadio), nodeNetwork(nodeRadio);
+  RF24Mesh masterMesh(masterRadio, masterNetwork), nodeMesh(nodeRadio, nodeNetwork);
+  RF24NetworkHeader header;
+  uint8_t payload[BENCH_PAYLOAD];
+  uint8_t i, r;
+  uint16_t n;
+  uint32_t delivered, airStart;
+
+  memset(payload, 0, sizeof(payload));
+  masterMesh.setNodeID(0);
+  masterMesh.begin(BENCH_CHANNEL, rates[0]);
+  nodeMesh.setNodeID(1);
+  nodeMesh.begin(BENCH_CHANNEL, rates[0]);
+  nodeRadio.setPALevel(RF24_PA_MIN);
+  nodeRadio.setRetries(5, 15);
+  printf("%d writes of %d bytes, PA min, 15 retries (goodput in kbit/s)\n", BENCH_WRITES, BENCH_PAYLOAD);
+  for(i=0; i<sizeof(losses); i++){
+    simSetPathLoss(losses[i]);
+    printf("  path loss %2u%%:", losses[i]);
+    for(r=0; r<sizeof(rates)/sizeof(rates[0]); r++){
+      masterRadio.setDataRate(rates[r]);
+      nodeRadio.setDataRate(rates[r]);
+      delivered = 0;
+      airStart = simAirtime();
+      for(n=0; n<BENCH_WRITES; n++){
+        if(nodeMesh.write(payload, MY_MESSAGE_T, sizeof(payload), 0)){
+          delivered++;
+        }
+        while(masterNetwork.available()){
+          masterNetwork.read(header, payload, sizeof(payload));
+        }
+      }
+      printf(" %4s %5lu", rateNames[r], (unsigned long)goodput(delivered * BENCH_PAYLOAD, airStart));
+    }
+    printf("\n");
+  }
+  simSetPathLoss(0);
+}
+
+int main(int argc, char **argv)
+{
+  SimNode *node;
+  MyMessage message(1, V_TEMP);
+  char command[MY_GATEWAY_MAX_SEND_LENGTH];
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i, level, changes, commandLength;
+  uint32_t now = 1, start, airStart, sent, delivered, bytes;
+  bool ok = true;
+  int out, n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  srand(1);
+  benchRates();
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(1, groups);
+  while(!node->step() && now < 10000){
+    simSetClock(++now);
+    masterListen();
+    Serial.flushTo(out);
+  }
+  if(!node->wave.isSynchronized()){
+    fprintf(stderr, "Node not synchronized\n");
+    return 1;
+  }
+
+  commandLength = snprintf(command, sizeof(command), "1;1;%d;0;%d;1\n", C_SET, V_STATUS);
+  printf("\nAdaptation, %d s per path loss, traffic every %d ms both ways\n",
+    BENCH_PHASE / 1000, BENCH_TRAFFIC_DELAY);
+  printf("  loss  rate  PA  changes  values     commands   goodput kbit/s\n");
+  for(i=0; i<sizeof(losses); i++){
+    simSetPathLoss(losses[i]);
+    start = now;
+    airStart = simAirtime();
+    level = masterRateLevel();
+    changes = 0;
+    sent = delivered = bytes = commands = 0;
+    while(now - start < BENCH_PHASE){
+      simSetClock(++now);
+      if(now % BENCH_TRAFFIC_DELAY == 0 && node->wave.isSynchronized()){
+        message.set((int16_t)(now / BENCH_TRAFFIC_DELAY % 100));
+        sent++;
+        if(node->write(message)){
+          delivered++;
+          bytes += strlen(node->wave.protocolFormat(message)) + 1;
+        }
+        Serial.feed(command, commandLength);
+      }
+      masterListen();
+      node->step();
+      Serial.flushTo(out);
+      if(masterRateLevel() != level){
+        level = masterRateLevel();
+        changes++;
+      }
+    }
+    /* Node got the announce or found master again by scanning */
+    for(n=0; n<1000 && node->wave.dataRateLevel() != masterRateLevel(); n++){
+      simSetClock(++now);
+      masterListen();
+      node->step();
+      Serial.flushTo(out);
+    }
+    if(node->wave.dataRateLevel() != masterRateLevel()){
+      fprintf(stderr, "Path loss %u%%: node at %s, master at %s\n", losses[i],
+        rateNames[node->wave.dataRateLevel()], rateNames[masterRateLevel()]);
+      ok = false;
+    }
+    /* Commands as read by master, values as formatted by node */
+    bytes += commands * commandLength;
+    printf("  %3u%%  %4s  %2u  %7u  %4lu/%-4lu  %4lu/%-4lu  %14lu\n", losses[i], rateNames[level], masterPALevel(),
+      changes, (unsigned long)delivered, (unsigned long)sent, (unsigned long)commands, (unsigned long)sent,
+      (unsigned long)goodput(bytes, airStart));
+  }
+  return ok ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * \file replay.cpp
+ * \brief Replay of a gateway capture on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Feeds the records of a capture file (rf24wave-gateway -c) to a master on
+ * the sim radio, with millis() following the recorded times one ms at a
+ * time, so timers fire as they did on the gateway. Frames sent by the master
+ * are acked and discarded. Controller output goes to stdout, so two replays
+ * of the same capture can be compared, and the time spent by listen() on
+ * each frame type goes to stderr.
+ *
+ * Usage: rf24wave-replay [-q] file
+ *   -q  Do not print controller output
+ *
+ */
+#include <RF24.h>
+#include <RF24Network.h>
+#include <RF24Mesh.h>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "RF24Wave.h"
+
+RF24 radio(0, 0);
+RF24Network network(radio);
+RF24Mesh mesh(radio, network);
+RF24Wave wave(radio, network, mesh);
+
+typedef struct{
+  uint32_t frames;
+  uint64_t ns;
+}replay_profile_t;
+
+static replay_profile_t profile[256];
+
+static uint32_t readLong(const uint8_t *data)
+{
+  return data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static uint64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Runs the master until the recorded time, as the gateway poll timer did */
+static void runUntil(uint32_t &clock, uint32_t time, int out)
+{
+  while((int32_t)(time - clock) > 0){
+    simSetClock(++clock);
+    wave.listen();
+    Serial.flushTo(out);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t record[CAPTURE_HEADER_SIZE + 255];
+  RF24NetworkHeader header;
+  uint32_t clock = 0, first = 0, time, records = 0;
+  uint64_t start, elapsed, total = 0;
+  uint16_t from;
+  uint8_t NID, type, size;
+  bool started = false;
+  FILE *file;
+  int out = STDOUT_FILENO, n;
+
+  while((n = getopt(argc, argv, "q")) != -1){
+    if(n == 'q'){
+      out = open("/dev/null", O_WRONLY);
+    }else{
+      optind = argc;
+      break;
+    }
+  }
+  if(optind != argc - 1){
+    fprintf(stderr, "Usage: %s [-q] file\n", argv[0]);
+    return 1;
+  }
+  file = fopen(argv[optind], "rb");
+  if(!file){
+    perror(argv[optind]);
+    return 1;
+  }
+
+  simSetDiscard(true);
+  Serial.begin(115200);
+  while(fread(record, 1, CAPTURE_HEADER_SIZE, file) == CAPTURE_HEADER_SIZE){
+    time = readLong(record);
+    from = record[4] | record[5] << 8;
+    NID = record[6];
+    type = record[7];
+    size = record[8];
+    if(fread(record + CAPTURE_HEADER_SIZE, 1, size, file) != size){
+      fprintf(stderr, "Truncated record %lu\n", (unsigned long)records);
+      break;
+    }
+    if(!started){
+      /* Master starts with the capture, its timers from the first record */
+      clock = first = time;
+      simSetClock(clock);
+      wave.begin();
+      started = true;
+    }
+    runUntil(clock, time, out);
+    records++;
+    if(type == CAPTURE_CONTROLLER_T){
+      Serial.feed((const char *)record + CAPTURE_HEADER_SIZE, size);
+      do{
+        wave.listen();
+      }while(Serial.available());
+      Serial.flushTo(out);
+      continue;
+    }
+    /* Sender known by master when recorded keeps its address */
+    if(NID != 255 && mesh.getAddress(NID) != from){
+      mesh.setStaticAddress(NID, from);
+    }
+    header = RF24NetworkHeader(0, type);
+    header.from_node = from;
+    network.deliver(header, record + CAPTURE_HEADER_SIZE, size);
+    start = nowNs();
+    while(network.available()){
+      wave.listen();
+    }
+    elapsed = nowNs() - start;
+    profile[type].frames++;
+    profile[type].ns += elapsed;
+    total += elapsed;
+    Serial.flushTo(out);
+  }
+  fclose(file);
+  Serial.flushTo(out);
+
+  fprintf(stderr, "%lu records over %lu ms\n", (unsigned long)records, (unsigned long)(clock - first));
+  fprintf(stderr, "type  frames  total us  avg us\n");
+  for(n=1; n<256; n++){
+    if(profile[n].frames){
+      fprintf(stderr, "%4d  %6lu  %8.0f  %6.2f\n", n, (unsigned long)profile[n].frames,
+        profile[n].ns / 1000.0, profile[n].ns / 1000.0 / profile[n].frames);
+    }
+  }
+  fprintf(stderr, "all           %8.0f\n", total / 1000.0);
+  return 0;
+}
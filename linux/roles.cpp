@@ -0,0 +1,111 @@
+/**
+ * \file roles.cpp
+ * \brief Master, node and repeater built into one unit on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once, without role flags, see ROLES in the Makefile: each role is
+ * its own instantiation of RF24WaveCore. A repeater and a node join master:
+ *  - the node must join group 1, the repeater must get an address and be
+ *    in no group.
+ *  - once master gave its address to another node, the repeater must find
+ *    out within REPEATER_CHECK_DELAY and get its address back.
+ *  - the repeater, without groups nor queues, must take less RAM than
+ *    node and master.
+ * Exits with 1 if one of these fails.
+ *
+ * Usage: rf24wave-roles [-v]
+ *   -v  Print serial output of all roles
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** NodeID of the repeater */
+#define ROLES_REPEATER          50
+/** Address master gives away in place of the repeater's */
+#define ROLES_STOLEN            051
+
+int main(int argc, char **argv)
+{
+  RF24 masterRadio(0, 0), repeaterRadio(0, 0);
+  RF24Network masterNetwork(masterRadio), repeaterNetwork(repeaterRadio);
+  RF24Mesh masterMesh(masterRadio, masterNetwork), repeaterMesh(repeaterRadio, repeaterNetwork);
+  RF24WaveCore<MasterPolicy> master(masterRadio, masterNetwork, masterMesh);
+  RF24WaveCore<RepeaterPolicy> repeater(repeaterRadio, repeaterNetwork, repeaterMesh, ROLES_REPEATER);
+  SimNode *node;
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i;
+  uint32_t now = 1, start;
+  int out, n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  master.begin();
+  repeater.begin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(1, groups);
+  while(now < 5000){
+    simSetClock(++now);
+    master.listen();
+    repeater.listen();
+    node->step();
+    Serial.flushTo(out);
+  }
+  if(!node->wave.isSynchronized() || !master.isPresent(1, 1)){
+    fprintf(stderr, "Node not synchronized\n");
+    return 1;
+  }
+  if(masterMesh.getAddress(ROLES_REPEATER) < 0 || !repeaterMesh.checkConnection()){
+    fprintf(stderr, "Repeater has no address\n");
+    return 1;
+  }
+  for(i=1; i<=MAX_GROUPS; i++){
+    if(master.isPresent(ROLES_REPEATER, i)){
+      fprintf(stderr, "Repeater in group %d of master\n", i);
+      return 1;
+    }
+  }
+  printf("Node joined group 1, repeater joined at address 0%o in no group\n",
+    masterMesh.getAddress(ROLES_REPEATER));
+
+  /* Repeater no longer has the address master knows it at */
+  masterMesh.setStaticAddress(ROLES_REPEATER, ROLES_STOLEN);
+  start = now;
+  while(now - start < REPEATER_CHECK_DELAY + 1000 && !repeaterMesh.checkConnection()){
+    simSetClock(++now);
+    master.listen();
+    repeater.listen();
+    node->step();
+    Serial.flushTo(out);
+  }
+  if(!repeaterMesh.checkConnection()){
+    fprintf(stderr, "Repeater did not renew its address in %lu ms\n", (unsigned long)(now - start));
+    return 1;
+  }
+  printf("Repeater renewed its address after %lu ms\n", (unsigned long)(now - start));
+
+  if(sizeof(repeater) >= sizeof(node->wave) || sizeof(repeater) >= sizeof(master)){
+    fprintf(stderr, "Core sizes: repeater %u, node %u, master %u\n",
+      (unsigned)sizeof(repeater), (unsigned)sizeof(node->wave), (unsigned)sizeof(master));
+    return 1;
+  }
+  printf("Core sizes: repeater %u, node %u, master %u bytes\n",
+    (unsigned)sizeof(repeater), (unsigned)sizeof(node->wave), (unsigned)sizeof(master));
+  return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * \file scenario.h
+ * \brief Nodes of host scenarios on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * A scenario runs its master and all its nodes in one thread, so a node
+ * cannot wait in begin() for its association. SimNode joins the way
+ * connect() and synchronizeAssociations() do, one step per call.
+ *
+ */
+
+#ifndef __LINUX_SCENARIO_H
+#define __LINUX_SCENARIO_H
+
+#include <RF24.h>
+#include <RF24Network.h>
+#include <RF24Mesh.h>
+
+#include "RF24Wave.h"
+
+#if !defined(WAVE_MASTER)
+class SimNode
+{
+  public:
+    SimNode(uint8_t NID, uint8_t *groups):
+    radio(0, 0), network(radio), mesh(radio, network), wave(radio, network, mesh, NID, groups),
+    attempt(0), last(millis())
+    {
+      mesh.setNodeID(NID);
+      mesh.begin(WAVE_CHANNEL, WAVE_DATA_RATE);
+      wave.resetListGroup();
+      wait = wave.joinBackoff(0);
+    }
+
+    /* One turn of connect(), synchronizeAssociations() or listen() */
+    bool step()
+    {
+      uint32_t currentTimer = millis();
+      if(wave.isSynchronized()){
+        wave.listen();
+        return true;
+      }
+      mesh.update();
+      if(currentTimer - last > wait){
+        last = currentTimer;
+        if(wave.isAssociated()){
+          wave.requestSynchronize();
+        }else{
+          wave.requestAssociations();
+        }
+        wait = JOIN_RETRY_DELAY + wave.joinBackoff(++attempt);
+      }
+      if(wave.isAssociated()){
+        wave.confirmSynchronize();
+        return false;
+      }
+      wave.confirmAssociations();
+      if(wave.isAssociated()){
+        attempt = 0;
+        wait = wave.joinBackoff(0);
+      }
+      return false;
+    }
+
+    /* Value to controller in one frame: send() would wait between retries */
+    bool write(MyMessage &message)
+    {
+      char *line;
+      message.sender = mesh.getNodeID();
+      mSetCommand(message, C_SET);
+      line = wave.protocolFormat(message);
+      return wave.meshWrite(line, MY_MESSAGE_T, strlen(line) + 1);
+    }
+
+    RF24 radio;
+    RF24Network network;
+    RF24Mesh mesh;
+    RF24WaveCore<NodePolicy> wave;
+
+  private:
+    uint8_t attempt;
+    uint32_t last;
+    uint32_t wait;
+};
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * \file RF24.h
+ * \brief In-process radio stand-in for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Implements the part of the RF24 API used by RF24Wave. Frames never leave
+ * the process: every RF24Mesh instance is attached to the same simulated
+ * air (see RF24Mesh.h), so several nodes and masters can run side by side.
+ *
+ */
+
+#ifndef __SIM_RF24_H
+#define __SIM_RF24_H
+
+#include <Arduino.h>
+
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e;
+typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
+
+class RF24
+{
+  public:
+    RF24(uint16_t cePin, uint16_t csnPin);
+    bool begin();
+    void setPALevel(uint8_t level);
+    uint8_t getPALevel();
+    void setChannel(uint8_t channel);
+    uint8_t getChannel();
+    bool setDataRate(rf24_datarate_e speed);
+    rf24_datarate_e getDataRate();
+    void setRetries(uint8_t delay, uint8_t count);
+    uint8_t getARC();
+    bool testRPD();
+    void startListening();
+    void stopListening();
+
+  private:
+    friend class RF24Mesh;
+    uint8_t _paLevel;
+    uint8_t _channel;
+    rf24_datarate_e _dataRate;
+    uint8_t _retryDelay;
+    uint8_t _retryCount;
+    /* Retries of last frame sent, strength of last frame received */
+    uint8_t _arc;
+    bool _rpd;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * \file RF24Mesh.h
+ * \brief In-process mesh stand-in for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Nodes are attached to a shared simulated air when begin() is called.
+ * Node 0 keeps the DHCP table, other nodes get an address from it.
+ * simSetLoss() drops the given percentage of frames to exercise retries,
+ * simSetTypeLoss() only frames of one type.
+ * simSetClock() stops millis() at the given time to replay a capture,
+ * simSetDiscard() acks frames sent to nodes that are not simulated.
+ *
+ */
+
+#ifndef __SIM_RF24MESH_H
+#define __SIM_RF24MESH_H
+
+#include "RF24Network.h"
+
+#define MESH_DEFAULT_ADDRESS 04444
+
+/**
+ * @def SIM_MAX_NODES
+ * @brief Max nodes attached to the simulated air
+ */
+#ifndef SIM_MAX_NODES
+#define SIM_MAX_NODES 255
+#endif
+
+/**
+ * @def SIM_RPD_LOSS
+ * @brief Attempt loss in percent under which testRPD() reports strong signal
+ */
+#ifndef SIM_RPD_LOSS
+#define SIM_RPD_LOSS 20
+#endif
+
+/**
+ * @def SIM_FRAME_OVERHEAD
+ * @brief Bytes sent around each payload: preamble, address, control field,
+ * CRC and network header
+ */
+#ifndef SIM_FRAME_OVERHEAD
+#define SIM_FRAME_OVERHEAD 18
+#endif
+
+class RF24Mesh
+{
+  public:
+    RF24Mesh(RF24 &_radio, RF24Network &_network);
+    ~RF24Mesh();
+    bool begin(uint8_t channel = 97, rf24_datarate_e data_rate = RF24_1MBPS, uint32_t timeout = 7500);
+    uint8_t update();
+    bool write(const void *data, uint8_t msg_type, size_t size, uint8_t nodeID = 0);
+    void setNodeID(uint8_t nodeID);
+    void DHCP();
+    int16_t getNodeID(uint16_t address = MESH_DEFAULT_ADDRESS);
+    int16_t getAddress(uint8_t nodeID);
+    bool checkConnection();
+    uint16_t renewAddress(uint32_t timeout = 7500);
+    void setStaticAddress(uint8_t nodeID, uint16_t address);
+    void setChannel(uint8_t channel);
+    RF24Network& getNetwork();
+
+    typedef struct{
+      uint8_t nodeID;
+      uint16_t address;
+    }addrListStruct;
+
+    addrListStruct *addrList;
+    uint8_t addrListTop;
+    uint16_t mesh_address;
+    uint8_t _nodeID;
+
+  private:
+    friend RF24Mesh* simFindMaster(uint8_t channel, rf24_datarate_e rate);
+    RF24 &radio;
+    RF24Network &network;
+};
+
+void simSetLoss(uint8_t percent);
+void simSetTypeLoss(uint8_t type, uint8_t percent);
+void simSetPathLoss(uint8_t percent);
+void simSetNoise(uint8_t channel, uint8_t percent);
+/* Microseconds of air used by every write, retries included */
+uint32_t simAirtime();
+void simSetClock(uint32_t now);
+void simSetDiscard(bool enable);
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * \file RF24Network.h
+ * \brief In-process network stand-in for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ */
+
+#ifndef __SIM_RF24NETWORK_H
+#define __SIM_RF24NETWORK_H
+
+#include "RF24.h"
+
+#ifndef MAX_PAYLOAD_SIZE
+#define MAX_PAYLOAD_SIZE 144
+#endif
+
+/**
+ * @def SIM_QUEUE_SIZE
+ * @brief Frames buffered per simulated node
+ */
+#ifndef SIM_QUEUE_SIZE
+#define SIM_QUEUE_SIZE 32
+#endif
+
+struct RF24NetworkHeader
+{
+  uint16_t from_node;
+  uint16_t to_node;
+  uint16_t id;
+  unsigned char type;
+  unsigned char reserved;
+
+  RF24NetworkHeader();
+  RF24NetworkHeader(uint16_t _to, unsigned char _type = 0);
+};
+
+typedef struct{
+  RF24NetworkHeader header;
+  uint16_t size;
+  uint8_t payload[MAX_PAYLOAD_SIZE];
+}sim_frame_t;
+
+class RF24Network
+{
+  public:
+    RF24Network(RF24 &_radio);
+    void begin(uint16_t address);
+    uint8_t update();
+    bool available();
+    uint16_t peek(RF24NetworkHeader &header);
+    void peek(RF24NetworkHeader &header, void *message, uint16_t maxlen);
+    uint16_t read(RF24NetworkHeader &header, void *message, uint16_t maxlen);
+    bool deliver(const RF24NetworkHeader &header, const void *message, uint16_t len);
+
+    uint16_t node_address;
+
+  private:
+    RF24 &radio;
+    sim_frame_t queue[SIM_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+};
+
+#endif
@@ -0,0 +1,454 @@
+/**
+ * \file RF24Sim.cpp
+ * \brief In-process radio stand-in for the Linux gateway
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ */
+#include "RF24Mesh.h"
+#include <time.h>
+
+/* Simulated air: every mesh which called begin() */
+static RF24Mesh *air[SIM_MAX_NODES];
+static uint8_t airTop = 0;
+static uint8_t lossPercent = 0;
+static uint8_t typeLossPercent[256];
+static uint8_t pathLossPercent = 0;
+static uint8_t noisePercent[126];
+static uint16_t frameID = 0;
+static uint32_t airtime = 0;
+static bool clockManual = false;
+static uint32_t clockNow = 0;
+static bool discard = false;
+
+/* 1 for 250KBPS, 2 for 1MBPS, 3 for 2MBPS */
+static uint8_t simRateIndex(rf24_datarate_e rate)
+{
+  return rate == RF24_250KBPS ? 1 : (rate == RF24_1MBPS ? 2 : 3);
+}
+
+/* Bit time in quarters of microsecond */
+static uint8_t simBitTime(rf24_datarate_e rate)
+{
+  return rate == RF24_250KBPS ? 16 : (rate == RF24_1MBPS ? 4 : 2);
+}
+
+uint32_t millis(void)
+{
+  struct timespec ts;
+  if(clockManual){
+    return clockNow;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL;
+}
+
+void simSetLoss(uint8_t percent)
+{
+  lossPercent = percent;
+}
+
+void simSetTypeLoss(uint8_t type, uint8_t percent)
+{
+  typeLossPercent[type] = percent;
+}
+
+void simSetPathLoss(uint8_t percent)
+{
+  pathLossPercent = percent;
+}
+
+uint32_t simAirtime()
+{
+  return airtime;
+}
+
+void simSetClock(uint32_t now)
+{
+  clockManual = true;
+  clockNow = now;
+}
+
+void simSetDiscard(bool enable)
+{
+  discard = enable;
+}
+
+void simSetNoise(uint8_t channel, uint8_t percent)
+{
+  if(channel < sizeof(noisePercent)){
+    noisePercent[channel] = percent;
+  }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  (void)us;
+}
+
+/* Master heard by a radio: same channel and same data rate */
+RF24Mesh* simFindMaster(uint8_t channel, rf24_datarate_e rate)
+{
+  uint8_t i;
+  for(i=0; i<airTop; i++){
+    if(air[i]->_nodeID == 0 && air[i]->radio.getChannel() == channel
+        && air[i]->radio.getDataRate() == rate){
+      return air[i];
+    }
+  }
+  return NULL;
+}
+
+/***************************** RF24 *****************************************/
+
+RF24::RF24(uint16_t cePin, uint16_t csnPin):
+_paLevel(RF24_PA_MAX), _channel(76), _dataRate(RF24_1MBPS), _retryDelay(5), _retryCount(15),
+_arc(0), _rpd(true)
+{
+  (void)cePin;
+  (void)csnPin;
+}
+
+bool RF24::begin()
+{
+  return true;
+}
+
+void RF24::setPALevel(uint8_t level)
+{
+  _paLevel = level;
+}
+
+uint8_t RF24::getPALevel()
+{
+  return _paLevel;
+}
+
+void RF24::setChannel(uint8_t channel)
+{
+  _channel = channel;
+}
+
+uint8_t RF24::getChannel()
+{
+  return _channel;
+}
+
+bool RF24::setDataRate(rf24_datarate_e speed)
+{
+  _dataRate = speed;
+  return true;
+}
+
+rf24_datarate_e RF24::getDataRate()
+{
+  return _dataRate;
+}
+
+void RF24::setRetries(uint8_t delay, uint8_t count)
+{
+  _retryDelay = delay;
+  _retryCount = count;
+}
+
+uint8_t RF24::getARC()
+{
+  return _arc;
+}
+
+bool RF24::testRPD()
+{
+  /* Foreign traffic on channel, else strength of last frame received */
+  if(_channel < sizeof(noisePercent) && (uint8_t)(rand() % 100) < noisePercent[_channel]){
+    return true;
+  }
+  return _rpd;
+}
+
+void RF24::startListening()
+{
+}
+
+void RF24::stopListening()
+{
+  _rpd = false;
+}
+
+/***************************** RF24Network **********************************/
+
+RF24NetworkHeader::RF24NetworkHeader():
+from_node(0), to_node(0), id(0), type(0), reserved(0)
+{
+}
+
+RF24NetworkHeader::RF24NetworkHeader(uint16_t _to, unsigned char _type):
+from_node(0), to_node(_to), id(frameID++), type(_type), reserved(0)
+{
+}
+
+RF24Network::RF24Network(RF24 &_radio):
+node_address(MESH_DEFAULT_ADDRESS), radio(_radio), head(0), count(0)
+{
+}
+
+void RF24Network::begin(uint16_t address)
+{
+  node_address = address;
+}
+
+uint8_t RF24Network::update()
+{
+  return count ? queue[head].header.type : 0;
+}
+
+bool RF24Network::available()
+{
+  return count > 0;
+}
+
+uint16_t RF24Network::peek(RF24NetworkHeader &header)
+{
+  if(!count){
+    return 0;
+  }
+  header = queue[head].header;
+  return queue[head].size;
+}
+
+void RF24Network::peek(RF24NetworkHeader &header, void *message, uint16_t maxlen)
+{
+  if(!count){
+    return;
+  }
+  header = queue[head].header;
+  if(message){
+    memcpy(message, queue[head].payload, min(maxlen, queue[head].size));
+  }
+}
+
+uint16_t RF24Network::read(RF24NetworkHeader &header, void *message, uint16_t maxlen)
+{
+  uint16_t length;
+  if(!count){
+    return 0;
+  }
+  header = queue[head].header;
+  length = min(maxlen, queue[head].size);
+  if(message && length){
+    memcpy(message, queue[head].payload, length);
+  }
+  head = (head + 1) % SIM_QUEUE_SIZE;
+  count--;
+  return length;
+}
+
+bool RF24Network::deliver(const RF24NetworkHeader &header, const void *message, uint16_t len)
+{
+  sim_frame_t *frame;
+  if(count >= SIM_QUEUE_SIZE || len > MAX_PAYLOAD_SIZE){
+    return false;
+  }
+  frame = &queue[(head + count) % SIM_QUEUE_SIZE];
+  frame->header = header;
+  frame->size = len;
+  memcpy(frame->payload, message, len);
+  count++;
+  return true;
+}
+
+/***************************** RF24Mesh *************************************/
+
+RF24Mesh::RF24Mesh(RF24 &_radio, RF24Network &_network):
+addrList(NULL), addrListTop(0), mesh_address(MESH_DEFAULT_ADDRESS), _nodeID(0),
+radio(_radio), network(_network)
+{
+}
+
+RF24Mesh::~RF24Mesh()
+{
+  uint8_t i;
+  for(i=0; i<airTop; i++){
+    if(air[i] == this){
+      air[i] = air[--airTop];
+      break;
+    }
+  }
+  free(addrList);
+}
+
+bool RF24Mesh::begin(uint8_t channel, rf24_datarate_e data_rate, uint32_t timeout)
+{
+  uint8_t i;
+  radio.setChannel(channel);
+  radio.setDataRate(data_rate);
+  for(i=0; i<airTop && air[i] != this; i++);
+  if(i == airTop){
+    if(airTop >= SIM_MAX_NODES){
+      return false;
+    }
+    air[airTop++] = this;
+  }
+  if(_nodeID == 0){
+    if(!addrList){
+      addrList = (addrListStruct*)calloc(SIM_MAX_NODES, sizeof(addrListStruct));
+    }
+    mesh_address = 0;
+    network.begin(mesh_address);
+    return true;
+  }
+  return renewAddress(timeout) != MESH_DEFAULT_ADDRESS;
+}
+
+uint8_t RF24Mesh::update()
+{
+  return network.update();
+}
+
+bool RF24Mesh::write(const void *data, uint8_t msg_type, size_t size, uint8_t nodeID)
+{
+  uint8_t i, signalLoss;
+  uint16_t attemptLoss;
+  uint32_t frameTime;
+  int16_t address = getAddress(nodeID);
+  if(address < 0 || mesh_address == MESH_DEFAULT_ADDRESS){
+    return false;
+  }
+  /* Each attempt is lost with path loss, halved by each PA step and
+   * multiplied by the sensitivity lost at 1MBPS and 2MBPS */
+  signalLoss = pathLossPercent >> radio._paLevel;
+  attemptLoss = signalLoss * simRateIndex(radio._dataRate);
+  if(attemptLoss > 100){
+    attemptLoss = 100;
+  }
+  /* Preamble, address, PCF, CRC and network header around payload */
+  frameTime = (SIM_FRAME_OVERHEAD + size) * 8 * simBitTime(radio._dataRate) / 4;
+  radio._arc = 0;
+  airtime += frameTime;
+  while(attemptLoss && (uint16_t)(rand() % 100) < attemptLoss){
+    if(radio._arc >= radio._retryCount){
+      return false;
+    }
+    radio._arc++;
+    airtime += (radio._retryDelay + 1) * 250UL + frameTime;
+  }
+  if(lossPercent && (uint8_t)(rand() % 100) < lossPercent){
+    return false;
+  }
+  if(typeLossPercent[msg_type] && (uint8_t)(rand() % 100) < typeLossPercent[msg_type]){
+    return false;
+  }
+  for(i=0; i<airTop; i++){
+    if(air[i]->mesh_address == (uint16_t)address && air[i] != this
+        && air[i]->radio._channel == radio._channel
+        && air[i]->radio._dataRate == radio._dataRate){
+      RF24NetworkHeader header(address, msg_type);
+      header.from_node = mesh_address;
+      /* Received power does not depend on data rate */
+      air[i]->radio._rpd = signalLoss < SIM_RPD_LOSS;
+      return air[i]->network.deliver(header, data, size);
+    }
+  }
+  return discard;
+}
+
+void RF24Mesh::setNodeID(uint8_t nodeID)
+{
+  _nodeID = nodeID;
+}
+
+void RF24Mesh::DHCP()
+{
+  /* Addresses are assigned in renewAddress() */
+}
+
+int16_t RF24Mesh::getNodeID(uint16_t address)
+{
+  RF24Mesh *master;
+  uint8_t i;
+  if(address == MESH_DEFAULT_ADDRESS){
+    return _nodeID;
+  }
+  if(address == 0){
+    return 0;
+  }
+  master = simFindMaster(radio._channel, radio._dataRate);
+  if(master){
+    for(i=0; i<master->addrListTop; i++){
+      if(master->addrList[i].address == address){
+        return master->addrList[i].nodeID;
+      }
+    }
+  }
+  return -1;
+}
+
+int16_t RF24Mesh::getAddress(uint8_t nodeID)
+{
+  RF24Mesh *master;
+  uint8_t i;
+  if(nodeID == 0){
+    return 0;
+  }
+  master = simFindMaster(radio._channel, radio._dataRate);
+  if(master){
+    for(i=0; i<master->addrListTop; i++){
+      if(master->addrList[i].nodeID == nodeID){
+        return master->addrList[i].address;
+      }
+    }
+  }
+  return -1;
+}
+
+bool RF24Mesh::checkConnection()
+{
+  return simFindMaster(radio._channel, radio._dataRate) != NULL && getAddress(_nodeID) == (int16_t)mesh_address;
+}
+
+uint16_t RF24Mesh::renewAddress(uint32_t timeout)
+{
+  RF24Mesh *master = simFindMaster(radio._channel, radio._dataRate);
+  (void)timeout;
+  if(master == this){
+    return mesh_address;
+  }
+  if(!master){
+    mesh_address = MESH_DEFAULT_ADDRESS;
+    return mesh_address;
+  }
+  /* Flat topology: every node is a direct child of the master */
+  master->setStaticAddress(_nodeID, _nodeID);
+  mesh_address = _nodeID;
+  network.begin(mesh_address);
+  return mesh_address;
+}
+
+void RF24Mesh::setStaticAddress(uint8_t nodeID, uint16_t address)
+{
+  uint8_t i;
+  if(!addrList){
+    return;
+  }
+  for(i=0; i<addrListTop; i++){
+    if(addrList[i].nodeID == nodeID){
+      addrList[i].address = address;
+      return;
+    }
+  }
+  if(addrListTop < SIM_MAX_NODES){
+    addrList[addrListTop].nodeID = nodeID;
+    addrList[addrListTop].address = address;
+    addrListTop++;
+  }
+}
+
+void RF24Mesh::setChannel(uint8_t channel)
+{
+  radio.setChannel(channel);
+}
+
+RF24Network& RF24Mesh::getNetwork()
+{
+  return network;
+}
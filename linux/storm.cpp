@@ -0,0 +1,160 @@
+/**
+ * \file storm.cpp
+ * \brief Join storm of more than a hundred nodes on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master (WAVE_JOIN_BATCH) and once as node, see SCENARIO in
+ * the Makefile. All nodes are powered together and take one join step
+ * (see scenario.h) per ms of simulated time. Master reads
+ * STORM_MASTER_FRAMES frames per ms and each radio queues SIM_QUEUE_SIZE
+ * frames: the sim has no collision model, so a full queue stands in for
+ * collisions.
+ *
+ * Once every node is synchronized and batches are over, each node must
+ * know the members of its groups as master does. Exits with 1 otherwise,
+ * or if some node is not synchronized after STORM_TIMEOUT.
+ *
+ * Usage: rf24wave-storm [-v] [nodes]
+ *   -v  Print serial output of master and nodes
+ *
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+/** Nodes joining when none is given */
+#define STORM_NODES             120
+/** Frames master reads in one ms */
+#define STORM_MASTER_FRAMES     4
+/** Delay in ms of simulated time for every node to be synchronized */
+#define STORM_TIMEOUT           60000
+/** Delay in ms left to last batches once every node is synchronized */
+#define STORM_SETTLE            3000
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+bool masterIsPresent(uint8_t NID, uint8_t GID);
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+bool masterIsPresent(uint8_t NID, uint8_t GID)
+{
+  return wave.isPresent(NID, GID);
+}
+
+#else
+/***************************** Node unit ************************************/
+
+/* Node knows the members master has in each of its groups */
+static bool checkGroups(SimNode **nodes, uint8_t count, uint8_t NID, uint8_t GID)
+{
+  uint8_t i;
+  bool ok = true;
+  for(i=1; i<=count; i++){
+    if(nodes[NID-1]->wave.isPresent(i, GID) != masterIsPresent(i, GID)){
+      fprintf(stderr, "Node %d: node %d in group %d %s\n", NID, i, GID,
+        masterIsPresent(i, GID) ? "missing" : "unknown to master");
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  SimNode **nodes;
+  uint8_t groups[MAX_GROUPS];
+  uint8_t i, GID, count = STORM_NODES, synced = 0, members = 0;
+  uint32_t now = 1, done = 0;
+  bool ok = true;
+  int out, n;
+
+  out = open("/dev/null", O_WRONLY);
+  while((n = getopt(argc, argv, "v")) != -1){
+    if(n == 'v'){
+      out = STDOUT_FILENO;
+    }else{
+      optind = argc;
+      break;
+    }
+  }
+  if(optind < argc - 1 || (optind == argc - 1 && (atoi(argv[optind]) < 1 || atoi(argv[optind]) >= 255))){
+    fprintf(stderr, "Usage: %s [-v] [nodes]\n", argv[0]);
+    return 1;
+  }
+  if(optind == argc - 1){
+    count = atoi(argv[optind]);
+  }
+
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  nodes = new SimNode*[count];
+  memset(groups, 0, sizeof(groups));
+  for(i=0; i<count; i++){
+    groups[0] = i % MAX_GROUPS + 1;
+    nodes[i] = new SimNode(i + 1, groups);
+  }
+
+  while(synced < count && now < STORM_TIMEOUT){
+    simSetClock(++now);
+    for(n=0; n<STORM_MASTER_FRAMES; n++){
+      masterListen();
+    }
+    synced = 0;
+    for(i=0; i<count; i++){
+      synced += nodes[i]->step();
+    }
+    Serial.flushTo(out);
+  }
+  done = now;
+  while(now < done + STORM_SETTLE){
+    simSetClock(++now);
+    for(n=0; n<STORM_MASTER_FRAMES; n++){
+      masterListen();
+    }
+    for(i=0; i<count; i++){
+      nodes[i]->step();
+    }
+    Serial.flushTo(out);
+  }
+
+  if(synced < count){
+    fprintf(stderr, "%d of %d nodes synchronized after %d ms\n", synced, count, STORM_TIMEOUT);
+    return 1;
+  }
+  for(i=1; i<=count; i++){
+    GID = (i - 1) % MAX_GROUPS + 1;
+    if(masterIsPresent(i, GID)){
+      members++;
+      ok &= checkGroups(nodes, count, i, GID);
+    }
+  }
+  printf("%d nodes synchronized in %lu ms, %lu ms of air\n", count, (unsigned long)done - 1,
+    (unsigned long)simAirtime() / 1000);
+  printf("%d group members, %s\n", members, ok ? "all groups consistent" : "groups differ from master");
+  return ok ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * \file stream_bench.cpp
+ * \brief Stream throughput under frame loss, on the simulated radio
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Built once as master and once as node with WAVE_STREAM, see SCENARIO in
+ * the Makefile. A node streams the same data to master at each loss rate
+ * of simSetLoss(), which fails chunks and acknowledgements alike.
+ *
+ * millis() follows the air: each turn of the node and master takes the
+ * air time the sim counts for its frames, retries included, or
+ * BENCH_IDLE_US when nothing was sent. Bytes/s are those of
+ * streamThroughput(), so they are bounded by air time and STREAM_TIMEOUT
+ * stalls, CPU time of a real node is not counted. Exits with 1 if master
+ * does not get the data as sent.
+ *
+ * Usage: rf24wave-stream-bench [bytes]
+ *
+ */
+#include <fcntl.h>
+
+#include "scenario.h"
+
+/** Bytes streamed when none is given */
+#define BENCH_BYTES             4096
+/** Time in us of a turn without any frame */
+#define BENCH_IDLE_US           100
+/** Delay in ms of simulated time for one stream */
+#define BENCH_TIMEOUT           120000
+
+/* Master unit */
+void masterBegin();
+void masterListen();
+void masterReceive(uint8_t *buffer, uint16_t size);
+uint8_t masterReceiveStatus();
+
+#if defined(WAVE_MASTER)
+/***************************** Master unit **********************************/
+
+static RF24 radio(0, 0);
+static RF24Network network(radio);
+static RF24Mesh mesh(radio, network);
+static RF24Wave wave(radio, network, mesh);
+
+void masterBegin()
+{
+  wave.begin();
+}
+
+void masterListen()
+{
+  wave.listen();
+}
+
+void masterReceive(uint8_t *buffer, uint16_t size)
+{
+  wave.streamReceive(buffer, size);
+}
+
+uint8_t masterReceiveStatus()
+{
+  return wave.streamReceiveStatus();
+}
+
+#else
+/***************************** Node unit ************************************/
+
+int main(int argc, char **argv)
+{
+  static const uint8_t losses[] = {0, 5, 10, 20, 30};
+  SimNode *node;
+  uint8_t groups[MAX_GROUPS];
+  uint8_t *data, *received;
+  uint8_t i;
+  uint16_t length = BENCH_BYTES;
+  uint32_t now = 1, us, air, start;
+  bool ok = true;
+  int out, n;
+
+  if(argc > 2 || (argc == 2 && (atol(argv[1]) < 1 || atol(argv[1]) > 65535))){
+    fprintf(stderr, "Usage: %s [bytes]\n", argv[0]);
+    return 1;
+  }
+  if(argc == 2){
+    length = atol(argv[1]);
+  }
+  data = new uint8_t[length];
+  received = new uint8_t[length];
+  for(n=0; n<length; n++){
+    data[n] = rand();
+  }
+
+  out = open("/dev/null", O_WRONLY);
+  simSetClock(now);
+  randomSeed(1);
+  Serial.begin(115200);
+  masterBegin();
+  memset(groups, 0, sizeof(groups));
+  groups[0] = 1;
+  node = new SimNode(1, groups);
+  while(!node->step() && now < 10000){
+    simSetClock(++now);
+    masterListen();
+    Serial.flushTo(out);
+  }
+  if(!node->wave.isSynchronized()){
+    fprintf(stderr, "Node not synchronized\n");
+    return 1;
+  }
+
+  printf("%u bytes, %d bytes per chunk, window %d, timeout %d ms\n\n", length,
+    STREAM_CHUNK_SIZE, STREAM_WINDOW, STREAM_TIMEOUT);
+  printf("loss  bytes/s  frames  resends  duration ms  air ms\n");
+  us = now * 1000;
+  for(i=0; i<sizeof(losses); i++){
+    simSetLoss(losses[i]);
+    memset(received, 0, length);
+    masterReceive(received, length);
+    node->wave.streamSend(0, data, length);
+    start = simAirtime();
+    while(node->wave.streamSendStatus() == STREAM_BUSY && us / 1000 - now < BENCH_TIMEOUT){
+      air = simAirtime();
+      node->step();
+      masterListen();
+      Serial.flushTo(out);
+      us += simAirtime() != air ? simAirtime() - air : BENCH_IDLE_US;
+      simSetClock(us / 1000);
+    }
+    now = us / 1000;
+    if(node->wave.streamSendStatus() != STREAM_DONE){
+      printf("%3u%%  failed  %6u  %7u\n", losses[i], node->wave.streamStats().frames,
+        node->wave.streamStats().retransmissions);
+      continue;
+    }
+    if(masterReceiveStatus() != STREAM_DONE || memcmp(data, received, length)){
+      fprintf(stderr, "Loss %u%%: master got other data\n", losses[i]);
+      ok = false;
+    }
+    printf("%3u%%  %7lu  %6u  %7u  %11lu  %6lu\n", losses[i], (unsigned long)node->wave.streamThroughput(),
+      node->wave.streamStats().frames, node->wave.streamStats().retransmissions,
+      (unsigned long)node->wave.streamStats().duration, (unsigned long)(simAirtime() - start) / 1000);
+  }
+  return ok ? 0 : 1;
+}
+
+#endif
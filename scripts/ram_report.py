@@ -0,0 +1,33 @@
+"""
+Post build RAM budget report.
+
+Prints static RAM used by the firmware of the environment (one environment
+per role) and the biggest objects in it, so growth of buffers or queues is
+seen at each build.
+"""
+import subprocess
+
+Import("env")
+
+RAM_SIZE = int(env.BoardConfig().get("upload.maximum_ram_size", 2048))
+TOP_OBJECTS = 8
+
+
+def ram_report(source, target, env):
+    elf = str(target[0])
+    nm = env.subst("$SIZETOOL").replace("size", "nm") or "avr-nm"
+    output = subprocess.check_output([nm, "-C", "-S", "--size-sort", elf])
+    objects = []
+    for line in output.decode().splitlines():
+        fields = line.split(None, 3)
+        # Static RAM is .data (d) and .bss (b)
+        if len(fields) == 4 and fields[2].lower() in ("b", "d"):
+            objects.append((int(fields[1], 16), fields[3]))
+    used = sum(size for size, _ in objects)
+    print("RAM budget [%s]: %d/%d bytes static, %d left for stack and heap"
+          % (env["PIOENV"], used, RAM_SIZE, RAM_SIZE - used))
+    for size, name in sorted(objects, reverse=True)[:TOP_OBJECTS]:
+        print("  %5d  %s" % (size, name))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", ram_report)
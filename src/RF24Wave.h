@@ -12,15 +12,23 @@
 #ifndef __RF24WAVE_H
 #define __RF24WAVE_H
 
-#include <arduino.h>
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <RF24Mesh.h>
 #include <MyMessage.h>
+#if defined(WAVE_GATEWAY_TCP)
+#include <Ethernet.h>
+#endif
 
 #define MSG_GW_STARTUP_COMPLETE "Gateway startup complete."
 #define LIBRARY_VERSION "RF24Wave 1.0"
 #define NB_RETRY_SEND 10
 
-#ifdef WAVE_DEBUG
+/* printLine() of master goes through the TX queue, of other roles to serial */
+#if defined(WAVE_DEBUG) && defined(WAVE_TX_QUEUE) && !defined(WAVE_GATEWAY_TCP)
+#define P_DEBUG(x) printLine(PSTR(x));
+#elif defined(WAVE_DEBUG)
 #define P_DEBUG(x) Serial.println(F(x));
 #else
 #define P_DEBUG(x)
@@ -66,6 +74,15 @@
 #define MY_GATEWAY_MAX_CLIENTS (1u)
 #endif
 
+/**
+ * @def MY_GATEWAY_PORT
+ * @brief TCP port of controller server when WAVE_GATEWAY_TCP is defined.
+ * The sketch has to call Ethernet.begin() before RF24Wave::begin().
+ */
+#ifndef MY_GATEWAY_PORT
+#define MY_GATEWAY_PORT (5003u)
+#endif
+
 
 /**
  * @def GATEWAY_ADDRESS
@@ -75,6 +92,88 @@
 #define GATEWAY_ADDRESS (0u)
 #endif
 
+/**
+ * @def GROUP_ADDRESS_BASE
+ * @brief Destinations GROUP_ADDRESS_BASE+1 to GROUP_ADDRESS_BASE+MAX_GROUPS
+ * sent by controller address all nodes of groups 1 to MAX_GROUPS.
+ */
+#ifndef GROUP_ADDRESS_BASE
+#define GROUP_ADDRESS_BASE (200u)
+#endif
+
+#define IS_GROUP_ADDRESS(ID) ((ID) > GROUP_ADDRESS_BASE && (ID) <= GROUP_ADDRESS_BASE + MAX_GROUPS)
+
+/**
+ * @def WAVE_STANDBY_ID
+ * @brief NodeID of the standby master. When defined, master replicates its
+ * associations to this node and sends it heartbeats. Build the standby with
+ * WAVE_MASTER and WAVE_STANDBY: it joins as WAVE_STANDBY_ID and takes over
+ * node 0 when heartbeats stop and master does not answer its probes.
+ */
+#if defined(WAVE_STANDBY) && !defined(WAVE_STANDBY_ID)
+#define WAVE_STANDBY_ID (254u)
+#endif
+
+/**
+ * @def STANDBY_HEARTBEAT_DELAY
+ * @brief Delay in ms between two heartbeats sent by master to standby.
+ */
+#ifndef STANDBY_HEARTBEAT_DELAY
+#define STANDBY_HEARTBEAT_DELAY (1000u)
+#endif
+
+/**
+ * @def STANDBY_TIMEOUT
+ * @brief Delay in ms without heartbeat before standby takes over.
+ */
+#ifndef STANDBY_TIMEOUT
+#define STANDBY_TIMEOUT (5000u)
+#endif
+
+/**
+ * @def STANDBY_PROBES
+ * @brief Probes of master failed in a row before standby takes over.
+ * Heartbeats are not acked, so standby asks master with an acked frame
+ * once they stop, and keeps waiting while master answers.
+ */
+#ifndef STANDBY_PROBES
+#define STANDBY_PROBES (3u)
+#endif
+
+/**
+ * @def STANDBY_PROBE_DELAY
+ * @brief Delay in ms between two probes of master.
+ */
+#ifndef STANDBY_PROBE_DELAY
+#define STANDBY_PROBE_DELAY (1000u)
+#endif
+
+/**
+ * @def STANDBY_MAX_NODES
+ * @brief Max DHCP entries mirrored by standby.
+ */
+#ifndef STANDBY_MAX_NODES
+#define STANDBY_MAX_NODES (10u)
+#endif
+
+/**
+ * @def REPEATER_CHECK_DELAY
+ * @brief Delay in ms between two checks of its parent by a repeater, which
+ * renews its address when the check fails. Build a repeater with
+ * WAVE_REPEATER: it joins the mesh in no group and only relays.
+ */
+#ifndef REPEATER_CHECK_DELAY
+#define REPEATER_CHECK_DELAY (10000u)
+#endif
+
+/**
+ * @def GROUP_CMD_QUEUE_SIZE
+ * @brief Max group commands waiting to be fanned out by gateway.
+ */
+#ifndef GROUP_CMD_QUEUE_SIZE
+#define GROUP_CMD_QUEUE_SIZE (2u)
+#endif
+
 
 /***
  * Wave Message Types
@@ -91,6 +190,22 @@
 #define SYNCHRONIZE_MSG_T       69
 #define ACK_SYNCHRONIZE_MSG_T   70
 #define MY_MESSAGE_T            71
+#define STANDBY_MSG_T           72
+#define REPLICATE_MSG_T         73
+#define RATE_MSG_T              74
+#define LEAVE_MSG_T             75
+#define UPDATE_GROUP_MSG_T      76
+#define FIRE_MSG_T              77
+#define STAMPED_MSG_T           78
+#define NONCE_REQUEST_MSG_T     79
+#define NONCE_MSG_T             80
+#define PRESENT_MSG_T           81
+
+#define MASTER_HEARTBEAT_MSG_T  1
+#define STREAM_MSG_T            2
+#define STREAM_ACK_MSG_T        3
+#define OTA_MSG_T               4
+#define TIME_MSG_T              5
 
 /**
  * \defgroup defConfig Library config
@@ -102,13 +217,615 @@
 #define MAX_NODE_GROUPS         5
 /** Maximum groups */
 #define MAX_GROUPS              9
+/** Maximum groups a leaf node belongs to (rows of its association matrix) */
+#ifndef NODE_MAX_GROUPS
+#define NODE_MAX_GROUPS         3
+#endif
 /** Delay in ms between two print info */
 #define PRINT_DELAY             5000
+/** Data bytes carried by one stream chunk (one radio frame) */
+#define STREAM_CHUNK_SIZE       18
+/** Chunks in flight before an acknowledgement is needed (max 16) */
+#ifndef STREAM_WINDOW
+#define STREAM_WINDOW           8
+#endif
+/** Delay in ms without acknowledgement before missing chunks are resent */
+#ifndef STREAM_TIMEOUT
+#define STREAM_TIMEOUT          200
+#endif
+/** Resends without progress before a stream is aborted */
+#ifndef STREAM_MAX_RETRY
+#define STREAM_MAX_RETRY        10
+#endif
+/** Bytes of firmware carried by one block */
+#define FIRMWARE_BLOCK_SIZE     16
+/** Blocks after first missing one that a node tracks and requests at once */
+#define FIRMWARE_WINDOW         32
+/** Delay in ms without firmware block before node requests missing ones */
+#ifndef FIRMWARE_TIMEOUT
+#define FIRMWARE_TIMEOUT        500
+#endif
+/** Requests without answer before node gives up an update */
+#ifndef FIRMWARE_MAX_RETRY
+#define FIRMWARE_MAX_RETRY      20
+#endif
+/** Delay in ms without request before gateway closes an update */
+#ifndef FIRMWARE_SERVE_TIMEOUT
+#define FIRMWARE_SERVE_TIMEOUT  30000
+#endif
+/** Maximum pending group notifications */
+#ifndef NOTIF_QUEUE_SIZE
+#define NOTIF_QUEUE_SIZE        3
+#endif
+/** Pending values and events for the controller, one slot per child and type */
+#ifndef SEND_QUEUE_SIZE
+#define SEND_QUEUE_SIZE         4
+#endif
+/** Delay in ms before a value is sent again to the controller */
+#ifndef SEND_RETRY_DELAY
+#define SEND_RETRY_DELAY        250
+#endif
+/** Data rate nodes join with, and used by whole network without adaptation */
+#ifndef WAVE_DATA_RATE
+#define WAVE_DATA_RATE          RF24_250KBPS
+#endif
+/** Delay in ms between two choices of network data rate by master */
+#ifndef RATE_ADAPT_DELAY
+#define RATE_ADAPT_DELAY        30000
+#endif
+/** Delivered frames in percent under which a link makes data rate go down */
+#ifndef RATE_QUALITY_MIN
+#define RATE_QUALITY_MIN        95
+#endif
+/** Strong frames in percent each link needs for 1Mbps */
+#ifndef RATE_1MBPS_STRENGTH
+#define RATE_1MBPS_STRENGTH     50
+#endif
+/** Strong frames in percent each link needs for 2Mbps */
+#ifndef RATE_2MBPS_STRENGTH
+#define RATE_2MBPS_STRENGTH     80
+#endif
+/** Failed writes in a row after which a node searches the network again */
+#ifndef RATE_FALLBACK_FAILS
+#define RATE_FALLBACK_FAILS     5
+#endif
+/** Adapt periods a rate which lost frames is not tried again */
+#ifndef RATE_HOLD_PERIODS
+#define RATE_HOLD_PERIODS       10
+#endif
+/** Data rates tried by a node scanning for master */
+#if defined(WAVE_RATE_ADAPT)
+#define WAVE_SCAN_RATES         3
+#else
+#define WAVE_SCAN_RATES         1
+#endif
+/** Channel used by master when no survey is done, and tried first by nodes */
+#ifndef WAVE_CHANNEL
+#define WAVE_CHANNEL            110
+#endif
+/** First channel surveyed by master and scanned by nodes */
+#ifndef CHANNEL_SCAN_MIN
+#define CHANNEL_SCAN_MIN        90
+#endif
+/** Last channel surveyed by master and scanned by nodes */
+#ifndef CHANNEL_SCAN_MAX
+#define CHANNEL_SCAN_MAX        125
+#endif
+/** Gap between two surveyed channels */
+#ifndef CHANNEL_SCAN_STEP
+#define CHANNEL_SCAN_STEP       5
+#endif
+/** Carrier detect samples taken by master on each channel */
+#ifndef CHANNEL_SURVEY_SAMPLES
+#define CHANNEL_SURVEY_SAMPLES  100
+#endif
+/** Delay in ms a node waits for an address on each channel and data rate */
+#ifndef CHANNEL_SCAN_TIMEOUT
+#define CHANNEL_SCAN_TIMEOUT    1500
+#endif
+/** Data rate is chosen from link quality metrics */
+#if defined(WAVE_RATE_ADAPT) && !defined(WAVE_LINK_QUALITY)
+#define WAVE_LINK_QUALITY
+#endif
+/** Delay in ms between two adaptations of PA level and retries */
+#ifndef LINK_ADAPT_DELAY
+#define LINK_ADAPT_DELAY        10000
+#endif
+/** Links tracked at once, least used one is replaced */
+#ifndef LINK_MAX_NODES
+#define LINK_MAX_NODES          4
+#endif
+/** Frames sent on a link in a period before it counts for adaptation */
+#ifndef LINK_MIN_SAMPLES
+#define LINK_MIN_SAMPLES        8
+#endif
+/** Lowest PA level used by adaptation */
+#ifndef LINK_PA_MIN
+#define LINK_PA_MIN             RF24_PA_MIN
+#endif
+/** Highest PA level used by adaptation */
+#ifndef LINK_PA_MAX
+#define LINK_PA_MAX             RF24_PA_MAX
+#endif
+/** Lowest radio auto-retry count */
+#ifndef LINK_RETRY_MIN
+#define LINK_RETRY_MIN          3
+#endif
+/** Highest radio auto-retry count */
+#ifndef LINK_RETRY_MAX
+#define LINK_RETRY_MAX          15
+#endif
+/** Lost frames in percent above which a link is raised */
+#ifndef LINK_LOSS_HIGH
+#define LINK_LOSS_HIGH          5
+#endif
+/** Auto-retries per ten frames above which a link is raised */
+#ifndef LINK_ARC_HIGH
+#define LINK_ARC_HIGH           10
+#endif
+/** Auto-retries per ten frames below which a link may be lowered */
+#ifndef LINK_ARC_LOW
+#define LINK_ARC_LOW            3
+#endif
+/** Received frames above -64dBm (RPD) in percent needed to lower a link */
+#ifndef LINK_STRONG_MIN
+#define LINK_STRONG_MIN         50
+#endif
+/** Nodes tracked at once by admission control, least recently seen is replaced */
+#ifndef ADMIT_MAX_NODES
+#define ADMIT_MAX_NODES         8
+#endif
+/** Requests of one class a node may send back to back */
+#ifndef ADMIT_BURST
+#define ADMIT_BURST             3
+#endif
+/** Delay in ms for a node to earn one more request of each class */
+#ifndef ADMIT_REFILL
+#define ADMIT_REFILL            4000
+#endif
+/** Delay in ms between two rounds of network time sent by master */
+#ifndef TIME_SYNC_DELAY
+#define TIME_SYNC_DELAY         60000
+#endif
+/** C_STREAM type of controller message giving the time its next group
+ * command is actuated at: seconds of controller clock, 4 bytes little endian.
+ * With WAVE_GATEWAY_TCP, it applies to the next line of the same client. A
+ * time more than 24 days ahead is refused and the command fired on receipt */
+#ifndef FIRE_STREAM_TYPE
+#define FIRE_STREAM_TYPE        34
+#endif
+/** Scheduled commands a node keeps until their time */
+#ifndef TIME_FIRE_QUEUE
+#define TIME_FIRE_QUEUE         2
+#endif
+/** Largest clock drift in ppm a node corrects */
+#ifndef TIME_MAX_DRIFT
+#define TIME_MAX_DRIFT          5000
+#endif
+/** Duration in ms of one join slot */
+#ifndef JOIN_SLOT_TIME
+#define JOIN_SLOT_TIME          50
+#endif
+/** Unconnected analog input whose noise seeds random() of a node */
+#ifndef WAVE_ENTROPY_PIN
+#define WAVE_ENTROPY_PIN        A0
+#endif
+/** Slots a node picks its first join request from */
+#ifndef JOIN_SLOTS
+#define JOIN_SLOTS              16
+#endif
+/** Largest number of slots, window doubles after each unanswered request */
+#ifndef JOIN_MAX_SLOTS
+#define JOIN_MAX_SLOTS          256
+#endif
+/** Delay in ms a node waits for an answer before its next join slot */
+#ifndef JOIN_RETRY_DELAY
+#define JOIN_RETRY_DELAY        1000
+#endif
+/** Connect requests master answers together */
+#ifndef JOIN_BATCH_SIZE
+#define JOIN_BATCH_SIZE         8
+#endif
+/** Delay in ms master waits for more requests after first one of a batch */
+#ifndef JOIN_BATCH_DELAY
+#define JOIN_BATCH_DELAY        200
+#endif
+/** Delay in ms between two liveness checks of master */
+#ifndef LIVE_CHECK_DELAY
+#define LIVE_CHECK_DELAY        10000
+#endif
+/** Silent checks after which master sends heartbeat requests to a node */
+#ifndef LIVE_PROBE_PERIODS
+#define LIVE_PROBE_PERIODS      6
+#endif
+/** Silent checks after which master evicts a node from its groups */
+#ifndef LIVE_EVICT_PERIODS
+#define LIVE_EVICT_PERIODS      18
+#endif
+/** Nonces a node hands to a peer at once, at most 8 */
+#ifndef SIGN_POOL_SIZE
+#define SIGN_POOL_SIZE          8
+#endif
+/** Peers a node keeps nonce pools for, should cover its broadcast list */
+#ifndef SIGN_MAX_PEERS
+#define SIGN_MAX_PEERS          4
+#endif
+/** Shortest and longest truncated signature in bytes */
+#ifndef SIGN_MIN_SIZE
+#define SIGN_MIN_SIZE           4
+#endif
+#ifndef SIGN_MAX_SIZE
+#define SIGN_MAX_SIZE           8
+#endif
+/** Bytes of one nRF24 payload left after RF24Network header */
+#define SIGN_RADIO_PAYLOAD      24
+/** Delay in ms between two nonce requests */
+#ifndef SIGN_REQUEST_DELAY
+#define SIGN_REQUEST_DELAY      200
+#endif
+/** C_STREAM type of controller requests for a snapshot, and of its records */
+#ifndef SNAPSHOT_STREAM_TYPE
+#define SNAPSHOT_STREAM_TYPE    33
+#endif
+/** Bytes of a snapshot record sent to controller */
+#define SNAPSHOT_RECORD_SIZE    9
+/** Bytes of controller lines waiting for room in serial TX buffer */
+#ifndef GATEWAY_TX_QUEUE_SIZE
+#define GATEWAY_TX_QUEUE_SIZE   256
+#endif
+/** Line dropped when TX queue is full: oldest waiting (1) or new one (0) */
+#ifndef GATEWAY_TX_DROP_OLDEST
+#define GATEWAY_TX_DROP_OLDEST  1
+#endif
+/** Values reported by nodes kept by master to answer C_REQ of controller */
+#ifndef VALUE_CACHE_SIZE
+#define VALUE_CACHE_SIZE        8
+#endif
+/** Age in ms over which a cached value is requested from node again */
+#ifndef VALUE_CACHE_MAX_AGE
+#define VALUE_CACHE_MAX_AGE     300000UL
+#endif
+/** Bytes of a presentation frame, three radio fragments */
+#ifndef PRESENT_FRAME_SIZE
+#define PRESENT_FRAME_SIZE      72
+#endif
+/** Delay in ms before a presentation frame is sent again, doubled after
+ * each failure up to PRESENT_RETRY_SHIFT times */
+#ifndef PRESENT_RETRY_DELAY
+#define PRESENT_RETRY_DELAY     250
+#endif
+#ifndef PRESENT_RETRY_SHIFT
+#define PRESENT_RETRY_SHIFT     3
+#endif
+/** Payload bytes kept per captured frame, more than any RF24Wave frame */
+#ifndef CAPTURE_PAYLOAD
+#define CAPTURE_PAYLOAD         64
+#endif
+/** Bytes of capture ring buffer, used while no capture sink is set */
+#ifndef CAPTURE_RING_SIZE
+#define CAPTURE_RING_SIZE       256
+#endif
+/** Bytes of a capture record before its payload */
+#define CAPTURE_HEADER_SIZE     9
+/** Type of capture records holding bytes received from controller */
+#define CAPTURE_CONTROLLER_T    0
+/** Rules a node keeps (bytes each: sizeof(rule_t)) */
+#ifndef RULES_MAX
+#define RULES_MAX               6
+#endif
+/** C_STREAM type of controller messages loading a rule on a node */
+#ifndef RULE_STREAM_TYPE
+#define RULE_STREAM_TYPE        32
+#endif
+/** Request classes limited separately by admission control */
+#define ADMIT_CONNECT           0
+#define ADMIT_SYNCHRONIZE       1
+#define ADMIT_CLASSES           2
 
  /** @} */
 
 void receive(const MyMessage &message)  __attribute__((weak));
 
+class RF24Mesh;
+class RF24Network;
+
+/**
+ * @def WAVE_NS
+ * @brief Namespace of RF24WaveCore and its types for the feature flags a
+ * unit is built with
+ *
+ * Roles are instantiations of RF24WaveCore, each one with its own state
+ * and code, so any roles build into one unit. Types and code change with
+ * feature flags: namespace is named after them and is inline, so sketches
+ * keep naming RF24Wave, while units built with different flags link into
+ * the same program, e.g. master and nodes of a host simulation. Sizes set
+ * in build flags (MAX_GROUPS...) still have to match between units.
+ */
+#if defined(WAVE_DEBUG)
+#define WAVE_NS_DEBUG           _debug
+#else
+#define WAVE_NS_DEBUG
+#endif
+#if defined(WAVE_SERIAL_RECEIVE)
+#define WAVE_NS_SERIAL          _serial
+#else
+#define WAVE_NS_SERIAL
+#endif
+#if defined(WAVE_GATEWAY_TCP)
+#define WAVE_NS_TCP             _tcp
+#else
+#define WAVE_NS_TCP
+#endif
+#if defined(WAVE_TX_QUEUE)
+#define WAVE_NS_TX_QUEUE        _txqueue
+#else
+#define WAVE_NS_TX_QUEUE
+#endif
+#if defined(WAVE_STANDBY_ID)
+#define WAVE_NS_STANDBY         _standby
+#else
+#define WAVE_NS_STANDBY
+#endif
+#if defined(WAVE_OTA)
+#define WAVE_NS_OTA             _ota
+#else
+#define WAVE_NS_OTA
+#endif
+#if defined(WAVE_STREAM)
+#define WAVE_NS_STREAM          _stream
+#else
+#define WAVE_NS_STREAM
+#endif
+#if defined(WAVE_LINK_QUALITY)
+#define WAVE_NS_LINK            _link
+#else
+#define WAVE_NS_LINK
+#endif
+#if defined(WAVE_RATE_ADAPT)
+#define WAVE_NS_RATE            _rate
+#else
+#define WAVE_NS_RATE
+#endif
+#if defined(WAVE_CHANNEL_SCAN)
+#define WAVE_NS_SCAN            _scan
+#else
+#define WAVE_NS_SCAN
+#endif
+#if defined(WAVE_TIME_SYNC)
+#define WAVE_NS_TIME            _time
+#else
+#define WAVE_NS_TIME
+#endif
+#if defined(WAVE_LIVENESS)
+#define WAVE_NS_LIVENESS        _liveness
+#else
+#define WAVE_NS_LIVENESS
+#endif
+#if defined(WAVE_SNAPSHOT)
+#define WAVE_NS_SNAPSHOT        _snapshot
+#else
+#define WAVE_NS_SNAPSHOT
+#endif
+#if defined(WAVE_ADMISSION)
+#define WAVE_NS_ADMISSION       _admission
+#else
+#define WAVE_NS_ADMISSION
+#endif
+#if defined(WAVE_JOIN_BATCH)
+#define WAVE_NS_JOIN            _join
+#else
+#define WAVE_NS_JOIN
+#endif
+#if defined(WAVE_PRESENT_BATCH)
+#define WAVE_NS_PRESENT         _present
+#else
+#define WAVE_NS_PRESENT
+#endif
+#if defined(WAVE_SEND_COALESCE)
+#define WAVE_NS_COALESCE        _coalesce
+#else
+#define WAVE_NS_COALESCE
+#endif
+#if defined(WAVE_VALUE_CACHE)
+#define WAVE_NS_CACHE           _cache
+#else
+#define WAVE_NS_CACHE
+#endif
+#if defined(WAVE_CAPTURE)
+#define WAVE_NS_CAPTURE         _capture
+#else
+#define WAVE_NS_CAPTURE
+#endif
+#if defined(WAVE_SIGNING)
+#define WAVE_NS_SIGNING         _signing
+#else
+#define WAVE_NS_SIGNING
+#endif
+#if defined(WAVE_RULES)
+#define WAVE_NS_RULES           _rules
+#else
+#define WAVE_NS_RULES
+#endif
+#if defined(AMPLIFICATOR)
+#define WAVE_NS_AMPLIFICATOR    _pa
+#else
+#define WAVE_NS_AMPLIFICATOR
+#endif
+/* Arguments are expanded by WAVE_NS_NAME before being pasted */
+#define WAVE_NS_PASTE(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q, r, s, t, u, v) \
+  rf24wave##a##b##c##d##e##f##g##h##i##j##k##l##m##n##o##p##q##r##s##t##u##v
+#define WAVE_NS_NAME(...)       WAVE_NS_PASTE(__VA_ARGS__)
+#define WAVE_NS WAVE_NS_NAME(WAVE_NS_DEBUG, WAVE_NS_SERIAL, WAVE_NS_TCP, WAVE_NS_TX_QUEUE, \
+  WAVE_NS_STANDBY, WAVE_NS_OTA, WAVE_NS_STREAM, WAVE_NS_LINK, WAVE_NS_RATE, WAVE_NS_SCAN, \
+  WAVE_NS_TIME, WAVE_NS_LIVENESS, WAVE_NS_SNAPSHOT, WAVE_NS_ADMISSION, WAVE_NS_JOIN, \
+  WAVE_NS_PRESENT, WAVE_NS_COALESCE, WAVE_NS_CACHE, WAVE_NS_CAPTURE, WAVE_NS_SIGNING, \
+  WAVE_NS_RULES, WAVE_NS_AMPLIFICATOR)
+
+inline namespace WAVE_NS {
+
+/** Matches any childID, type or command in a sensor_route_t */
+#define WAVE_ANY                0xFF
+
+typedef void (*sensor_handler_t)(const MyMessage &message);
+
+/**
+ * \struct sensor_route_t
+ * \brief Binds messages for one sensor to a handler
+ *
+ * Routes are checked in order and first match wins. A table of routes can
+ * be declared static constexpr. Use WAVE_ANY as a wildcard; childID 255
+ * (the node itself) therefore cannot be matched alone.
+ */
+typedef struct{
+  uint8_t childID;
+  uint8_t type;
+  uint8_t command;
+  sensor_handler_t handler;
+}sensor_route_t;
+
+/**
+ * \defgroup defStream Stream status
+ * @{
+ */
+#define STREAM_IDLE             0
+#define STREAM_BUSY             1
+#define STREAM_DONE             2
+#define STREAM_FAILED           3
+ /** @} */
+
+/**
+ * \defgroup defRule Rule predicates and actions
+ * @{
+ */
+#define RULE_NONE               0
+#define RULE_ANY                1
+#define RULE_EQ                 2
+#define RULE_NE                 3
+#define RULE_GT                 4
+#define RULE_LT                 5
+
+#define RULE_SET_CHILD          0
+#define RULE_NOTIFY             1
+
+#define RULE_COPY_VALUE         0x01
+ /** @} */
+
+/**
+ * \struct rule_t
+ * \brief Local reaction of a node to a value it receives
+ *
+ * When a C_SET message from sender (a node ID, a group address to match
+ * any member of that group, or WAVE_ANY) for sensor and type passes
+ * "value op threshold", action sets local child (dispatched to its handler)
+ * or notifies the group peers. argument is the value sent, or the received
+ * value with RULE_COPY_VALUE. Integers first, so layout is the same on AVR
+ * and on host: a rule is loaded as the 16 bytes payload of a C_STREAM
+ * message. op RULE_NONE marks an empty slot.
+ */
+typedef struct{
+  int32_t threshold;
+  int32_t argument;
+  uint8_t sender;
+  uint8_t sensor;
+  uint8_t type;
+  uint8_t op;
+  uint8_t action;
+  uint8_t flags;
+  uint8_t childID;
+  uint8_t childType;
+}rule_t;
+
+/**
+ * \defgroup defOta Firmware update status
+ * @{
+ */
+#define OTA_IDLE                0
+#define OTA_CONFIG              1
+#define OTA_PUSH                2
+#define OTA_SERVE               3
+#define OTA_RECEIVING           4
+#define OTA_STAGED              5
+#define OTA_FAILED              6
+ /** @} */
+
+/**
+ * Callbacks reading and writing one firmware block in image storage
+ * (external flash, SD card or file on gateway).
+ */
+typedef bool (*firmware_reader_t)(uint16_t block, uint8_t *data);
+typedef bool (*firmware_writer_t)(uint16_t block, const uint8_t *data);
+
+/**
+ * Callback receiving stream data at its offset, chunks may come out of order.
+ */
+typedef void (*stream_sink_t)(uint8_t sender, uint16_t offset, const uint8_t *data, uint8_t length);
+
+/**
+ * \struct snapshot_node_t
+ * \brief State of one node of the network, as known by master
+ *
+ * groups has bit i set for membership of group i+1. seen is in seconds
+ * since the last frame received from the node, stamped per group slot by
+ * master. It is 0xFFFF for a node in no group, and stops growing after
+ * about 17 hours. quality and strength are those of link_stats_t, 255 if
+ * unknown. Sent to controller as 9 bytes
+ * in this order, integers little endian.
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint16_t address;
+  uint16_t groups;
+  uint16_t seen;
+  uint8_t quality;
+  uint8_t strength;
+}snapshot_node_t;
+
+/**
+ * \struct tx_queue_stats_t
+ * \brief Controller lines written, dropped by TX queue, and most bytes queued
+ */
+typedef struct{
+  uint32_t written;
+  uint32_t dropped;
+  uint16_t peak;
+}tx_queue_stats_t;
+
+/**
+ * \struct value_cache_t
+ * \brief Last value reported by a node for a child and type
+ *
+ * The message is kept as parsed from the node line, sender is the node.
+ */
+typedef struct{
+  MyMessage message;
+  uint32_t time;
+}value_cache_t;
+
+/**
+ * \struct value_cache_stats_t
+ * \brief C_REQ of controller answered by master, and forwarded to nodes
+ */
+typedef struct{
+  uint32_t hits;
+  uint32_t misses;
+}value_cache_stats_t;
+
+/**
+ * Callback receiving each capture record: time in ms (4 bytes), from_node
+ * (2), nodeID of sender (1, 255 if unknown), type (1) and size (1), then
+ * size bytes of payload. Integers are little endian.
+ */
+typedef void (*capture_sink_t)(const uint8_t *record, uint8_t length);
+
+/**
+ * \struct capture_stats_t
+ * \brief Records captured by gateway, and records lost by ring buffer
+ */
+typedef struct{
+  uint32_t captured;
+  uint32_t dropped;
+}capture_stats_t;
+
 /**
  * \struct info_node_t
  * \brief Structure of information message
@@ -126,11 +843,115 @@ typedef struct{
   uint8_t groupID;
 }update_msg_t;
 
+/**
+ * \struct update_group_msg_t
+ * \brief Members of a group after a batch of joins
+ */
+typedef struct{
+  uint8_t groupID;
+  uint8_t nodesID[MAX_NODE_GROUPS];
+}update_group_msg_t;
+
 typedef struct{
   uint8_t nodeID;
   uint8_t listGroupsID[MAX_GROUPS][MAX_NODE_GROUPS];
 }send_list_t;
 
+/**
+ * \struct format_scratch_t
+ * \brief Buffers used to format or parse one serial protocol line
+ */
+typedef struct{
+  char buffer[MY_GATEWAY_MAX_SEND_LENGTH];
+  char conv[MAX_PAYLOAD*2+1];
+}format_scratch_t;
+
+/**
+ * \struct sign_scratch_t
+ * \brief Signed notification: message, nonce index and truncated signature
+ */
+typedef struct{
+  uint8_t frame[HEADER_SIZE + MAX_PAYLOAD + 1 + SIGN_MAX_SIZE];
+}sign_scratch_t;
+
+/**
+ * \union scratch_phase_t
+ * \brief Buffers of protocol phases, taken with a ScratchLease
+ */
+typedef union{
+  info_node_t info;
+  send_list_t list;
+#if defined(WAVE_SIGNING)
+  sign_scratch_t sign;
+#endif
+}scratch_phase_t;
+
+/**
+ * \struct wave_scratch_t
+ * \brief Scratch arena shared by protocol phases
+ *
+ * A phase never runs while another one holds its buffers, so phases overlap
+ * and cost the size of the biggest one. format is resident: a line may be
+ * formatted for the controller while a phase is leased, so it is apart.
+ */
+typedef struct{
+  format_scratch_t format;
+  scratch_phase_t phase;
+}wave_scratch_t;
+
+/**
+ * \struct ScratchPhase
+ * \brief Layouts a ScratchLease may take, one per member of scratch_phase_t
+ */
+template <typename T>
+struct ScratchPhase
+{
+  static const bool leased = false;
+};
+
+template <>
+struct ScratchPhase<info_node_t>
+{
+  static const bool leased = true;
+};
+
+template <>
+struct ScratchPhase<send_list_t>
+{
+  static const bool leased = true;
+};
+
+#if defined(WAVE_SIGNING)
+template <>
+struct ScratchPhase<sign_scratch_t>
+{
+  static const bool leased = true;
+};
+#endif
+
+/**
+ * \class ScratchLease
+ * \brief Scoped access to one phase of the scratch arena
+ *
+ * Lease is cleared when taken and must not outlive the block that takes it.
+ * Layout that is not a phase, or phases overlapping format, are rejected at
+ * compile time.
+ */
+template <typename T>
+class ScratchLease
+{
+  public:
+    explicit ScratchLease(wave_scratch_t &scratch):
+    data(*reinterpret_cast<T *>(&scratch.phase))
+    {
+      static_assert(ScratchPhase<T>::leased, "Layout is not a phase of scratch arena");
+      static_assert(offsetof(wave_scratch_t, phase) >= sizeof(format_scratch_t),
+        "Phases overlap resident format layout");
+      memset(&data, 0, sizeof(T));
+    }
+    T &data;
+};
+
 struct broadcast_list{
   uint8_t nodeID;
   broadcast_list *next;
@@ -138,10 +959,525 @@ struct broadcast_list{
 
 typedef broadcast_list broadcast_list_t;
 
-class RF24Mesh;
-class RF24Network;
+/**
+ * \struct heartbeat_msg_t
+ * \brief Heartbeat sent by master to standby
+ *
+ * Each heartbeat carries one entry of the DHCP table, so standby mirrors
+ * the whole table after a few periods.
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint16_t address;
+}heartbeat_msg_t;
+
+/**
+ * \struct stream_chunk_t
+ * \brief One chunk of a stream
+ *
+ * Every chunk carries the total length so receiver can start on any chunk.
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint8_t streamID;
+  uint16_t seq;
+  uint16_t length;
+  uint8_t data[STREAM_CHUNK_SIZE];
+}stream_chunk_t;
+
+#define STREAM_CHUNK_HEADER (sizeof(stream_chunk_t) - STREAM_CHUNK_SIZE)
+
+/**
+ * \struct stream_ack_t
+ * \brief Selective acknowledgement of a stream
+ *
+ * All chunks before base are received, bit i of bitmap is set when chunk
+ * base+1+i is received.
+ */
+typedef struct{
+  uint8_t streamID;
+  uint16_t base;
+  uint16_t bitmap;
+}stream_ack_t;
+
+/**
+ * \struct stream_state_t
+ * \brief Window of a stream, used on both sides
+ */
+typedef struct{
+  uint8_t status;
+  uint8_t nodeID;
+  uint8_t streamID;
+  uint16_t length;
+  uint16_t base;
+  uint16_t bitmap;
+  uint16_t next;
+  uint8_t retry;
+  uint32_t lastTimer;
+}stream_state_t;
+
+/**
+ * \struct link_stats_t
+ * \brief Quality of the radio link with one node
+ *
+ * Counters cover the current adaptation period. quality is the percentage
+ * of frames delivered and strength the percentage of frames received above
+ * -64dBm, over the last period counted (255 before any). RPD is sampled
+ * once per mesh.update() of listen(), so frames it takes off the radio
+ * together share the strength of the last one: strength is approximate
+ * under bursts.
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint8_t quality;
+  uint8_t strength;
+  uint16_t sent;
+  uint16_t failed;
+  uint16_t retries;
+  uint16_t received;
+  uint16_t strong;
+}link_stats_t;
+
+/**
+ * \struct admit_state_t
+ * \brief Admission control state of one node on master
+ *
+ * Each request class has its own token bucket. request and answer keep the
+ * groups of the last CONNECT_MSG_T and of its ACK, valid while no
+ * association changed since (epoch).
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint8_t tokens[ADMIT_CLASSES];
+  uint32_t refillTimer;
+  uint32_t lastSeen;
+  uint16_t dropped;
+  uint8_t request[MAX_GROUPS];
+  uint8_t answer[MAX_GROUPS];
+  uint8_t epoch;
+  bool cached;
+}admit_state_t;
+
+/**
+ * \struct admit_counters_t
+ * \brief Requests dropped or answered from cache by master
+ */
+typedef struct{
+  uint16_t dropped[ADMIT_CLASSES];
+  uint16_t cached;
+}admit_counters_t;
+
+/**
+ * \struct stream_stats_t
+ * \brief Statistics of last stream sent
+ */
+typedef struct{
+  uint32_t bytes;
+  uint32_t duration;
+  uint16_t frames;
+  uint16_t retransmissions;
+}stream_stats_t;
+
+/**
+ * \struct firmware_msg_t
+ * \brief Firmware update message
+ *
+ * command is one of mysensor_stream ST_FIRMWARE_*. block is the block
+ * index, or the number of blocks for config messages. CRC of the image is
+ * carried in data of ST_FIRMWARE_CONFIG_RESPONSE. A ST_FIRMWARE_REQUEST
+ * asks for its first missing block and, through the bitmap of received
+ * blocks in data, for all missing blocks of the next FIRMWARE_WINDOW.
+ */
+typedef struct{
+  uint8_t command;
+  uint8_t nodeID;
+  uint16_t version;
+  uint16_t block;
+  uint8_t data[FIRMWARE_BLOCK_SIZE];
+}firmware_msg_t;
+
+#define FIRMWARE_MSG_HEADER (sizeof(firmware_msg_t) - FIRMWARE_BLOCK_SIZE)
+
+/**
+ * \struct ota_state_t
+ * \brief Progress of a firmware update
+ *
+ * On gateway, block and member point to next frame to push and staged is a
+ * bitmap of _otaPull entries which verified the image. On node, block is the
+ * first missing block, window a bitmap of blocks received after it and
+ * top the last block of pending request.
+ */
+typedef struct{
+  uint8_t status;
+  uint8_t groupID;
+  uint16_t version;
+  uint16_t blocks;
+  uint16_t crc;
+  uint16_t block;
+  uint8_t member;
+  uint8_t staged;
+  uint32_t window;
+  uint16_t top;
+  bool pull;
+  uint8_t retry;
+  uint32_t lastTimer;
+}ota_state_t;
+
+/**
+ * \struct ota_pull_t
+ * \brief Request of missing blocks being served by gateway for one node
+ *
+ * nodeID is the group member taken when update started, 0 once removed from
+ * the group. offset is the next block to serve after block, above
+ * FIRMWARE_WINDOW when request is served.
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint16_t block;
+  uint32_t window;
+  uint8_t offset;
+}ota_pull_t;
+
+/**
+ * \struct notif_slot_t
+ * \brief Pending group notification
+ *
+ * The message is kept in its binary form and sent with NOTIF_MSG_T to each
+ * node of the broadcast list, one frame per call of listen().
+ */
+typedef struct{
+  MyMessage message;
+  broadcast_list_t *cursor;
+  uint8_t retry;
+  bool started;
+}notif_slot_t;
+
+/**
+ * \struct send_slot_t
+ * \brief Pending message for the controller
+ *
+ * A new value of the same child and type replaces the message while it
+ * waits, events keep a slot each.
+ */
+typedef struct{
+  MyMessage message;
+  uint32_t timer;
+  uint8_t retry;
+  bool event;
+}send_slot_t;
+
+/**
+ * \struct group_cmd_t
+ * \brief Controller command being fanned out to a group
+ *
+ * members are the node IDs of the group when command was queued, each one
+ * cleared once delivered, given up or removed from the group.
+ */
+typedef struct{
+  MyMessage message;
+  uint8_t members[MAX_NODE_GROUPS];
+  uint8_t retry;
+#if defined(WAVE_TIME_SYNC)
+  /* Network time members actuate at, 0 to actuate on receipt */
+  uint32_t fireAt;
+#endif
+}group_cmd_t;
+
+/**
+ * \struct time_msg_t
+ * \brief Network time sent by master
+ *
+ * time is master millis(). epoch is controller time in seconds at network
+ * time epochTime, 0 while controller did not answer I_TIME.
+ */
+typedef struct{
+  uint32_t time;
+  uint32_t epoch;
+  uint32_t epochTime;
+}time_msg_t;
+
+/**
+ * \struct timed_msg_t
+ * \brief Message with a network time
+ *
+ * Time of reading for STAMPED_MSG_T, time of actuation for FIRE_MSG_T.
+ * Only header and payload of message are sent.
+ */
+typedef struct{
+  uint32_t time;
+  MyMessage message;
+}timed_msg_t;
+
+/**
+ * \struct nonce_msg_t
+ * \brief Pool of nonces handed by a node to one peer
+ *
+ * Peer signs its next count frames to nodeID with nonce and an index.
+ */
+typedef struct{
+  uint32_t nonce;
+  uint8_t nodeID;
+  uint8_t count;
+}nonce_msg_t;
+
+/**
+ * \struct sign_peer_t
+ * \brief Nonce pools shared with one peer
+ *
+ * tx pool was handed by peer and signs frames sent to it, rx pool was
+ * handed to peer and checks frames received from it. Each index of a pool
+ * is used once (rxUsed bits), so a recorded frame cannot be replayed.
+ */
+typedef struct{
+  uint8_t nodeID;
+  uint32_t txNonce;
+  uint8_t txNext;
+  uint8_t txCount;
+  uint32_t rxNonce;
+  uint8_t rxUsed;
+  uint8_t rxCount;
+}sign_peer_t;
+
+/**
+ * \struct sign_stats_t
+ * \brief Signed notifications counters of a node
+ */
+typedef struct{
+  uint16_t signedFrames;
+  uint16_t verified;
+  uint16_t rejected;
+  uint16_t requests;
+}sign_stats_t;
+
+/**
+ * \struct master_state_t
+ * \brief State only master keeps: controller link, joins and group fan-out
+ */
+struct master_state_t{
+#if defined(WAVE_OTA)
+  ota_pull_t _otaPull[MAX_NODE_GROUPS];
+  uint8_t _otaPullIndex = 0;
+#endif
+#if defined(WAVE_RATE_ADAPT)
+  uint32_t _rateTimer;
+  /* Highest level allowed until _rateHold periods have passed */
+  uint8_t _rateCeiling = 2;
+  uint8_t _rateHold = 0;
+#endif
+#if !defined(WAVE_GATEWAY_TCP)
+  /* Line received from controller is kept until newline, out of scratch */
+  char _serialBuffer[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+  uint8_t _serialInputPos = 0;
+#if defined(WAVE_TX_QUEUE)
+  /* Lines waiting for serial, each one after its length byte */
+  uint8_t _txQueue[GATEWAY_TX_QUEUE_SIZE];
+  uint16_t _txHead = 0;
+  uint16_t _txCount = 0;
+  tx_queue_stats_t _txStats;
+#endif
+#endif
+#if defined(WAVE_GATEWAY_TCP)
+  /* Each controller client has its own receive buffer */
+  EthernetServer _server{MY_GATEWAY_PORT};
+  EthernetClient _clients[MY_GATEWAY_MAX_CLIENTS];
+  char _clientBuffer[MY_GATEWAY_MAX_CLIENTS][MY_GATEWAY_MAX_RECEIVE_LENGTH];
+  uint8_t _clientInputPos[MY_GATEWAY_MAX_CLIENTS];
+  uint8_t _clientIndex = 0;
+  /* Client of the last line returned by gatewayTransportAvailable() */
+  uint8_t _clientFrom = 0;
+#endif
+#if defined(WAVE_JOIN_BATCH)
+  /* Connect requests waiting for the end of their batch */
+  info_node_t _joinQueue[JOIN_BATCH_SIZE];
+  uint8_t _joinCount = 0;
+  uint32_t _joinTimer;
+#endif
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+  /* Second of millis() each slot of listGroupsID was last heard at */
+  uint16_t _heard[MAX_GROUPS][MAX_NODE_GROUPS];
+  uint32_t _liveTimer;
+#endif
+#if defined(WAVE_ADMISSION)
+  admit_state_t _admits[ADMIT_MAX_NODES];
+  admit_counters_t _admitCounters;
+  /* Bumped on each association change, invalidates cached answers */
+  uint8_t _assocEpoch = 0;
+#endif
+#if defined(WAVE_TIME_SYNC)
+  uint32_t _timeTimer;
+  uint8_t _timeIndex = 0;
+  /* Controller time in seconds at millis() _epochLocal, 0 until known */
+  uint32_t _epoch = 0;
+  uint32_t _epochLocal;
+  /* Network time set by controller for its next group command, 0 if none */
+#if defined(WAVE_GATEWAY_TCP)
+  uint32_t _fireAt[MY_GATEWAY_MAX_CLIENTS] = {0};
+#else
+  uint32_t _fireAt = 0;
+#endif
+#endif
+#if defined(WAVE_VALUE_CACHE)
+  /* Filled in order, then the oldest entry is replaced */
+  value_cache_t _valueCache[VALUE_CACHE_SIZE];
+  uint8_t _valueCacheCount = 0;
+  value_cache_stats_t _valueCacheStats;
+#endif
+#if defined(WAVE_CAPTURE)
+  /* Records are streamed to sink, else kept in ring until read */
+  capture_sink_t _captureSink = NULL;
+  capture_stats_t _captureStats;
+  uint8_t _captureRing[CAPTURE_RING_SIZE];
+  uint16_t _captureHead = 0;
+  uint16_t _captureCount = 0;
+#endif
+  /* Ring buffer of group commands received from controller */
+  group_cmd_t _groupCmdQueue[GROUP_CMD_QUEUE_SIZE];
+  uint8_t _groupCmdHead = 0;
+  uint8_t _groupCmdCount = 0;
+#if defined(WAVE_STANDBY_ID)
+  /* Last heartbeat sent (master) or received (standby) */
+  uint32_t _lastHeartbeat;
+  uint8_t _heartbeatIndex = 0;
+#endif
+  /* Matrix to stock nodeID for each different groupID */
+  uint8_t listGroupsID[MAX_GROUPS][MAX_NODE_GROUPS];
+};
+
+/**
+ * \struct standby_state_t
+ * \brief State of master, and of standby until it takes over
+ */
+struct standby_state_t : master_state_t{
+  bool _standby = false;
+  bool _replicated = false;
+  /* Probes of master once heartbeats stopped */
+  uint8_t _probeFailures = 0;
+  uint32_t _lastProbe;
+  /* DHCP table mirrored from master */
+  heartbeat_msg_t _addrMirror[STANDBY_MAX_NODES];
+  uint8_t _addrMirrorTop = 0;
+};
+
+/**
+ * \struct node_state_t
+ * \brief State only a node keeps: its groups, their members and its queues
+ */
+struct node_state_t{
+#if defined(WAVE_OTA)
+  firmware_writer_t _otaWriter = NULL;
+  uint16_t _firmwareVersion = 0;
+#endif
+#if defined(WAVE_RATE_ADAPT)
+  uint8_t _writeFailures = 0;
+#endif
+  bool associated = false;
+  bool synchronized = false;
+  /* Struct to stock different group ID proper to this node */
+  uint8_t groupsID[MAX_GROUPS];
+  /* More groups than NODE_MAX_GROUPS were given, node does not join */
+  bool _groupsRefused = false;
+  broadcast_list_t *headBroadcastList = NULL;
+  /* Handler table set by sketch, weak receive() is used without one */
+  const sensor_route_t *_handlers = NULL;
+  uint8_t _handlerCount = 0;
+  uint8_t lengthBroadcastList = 0;
+  /* Ring buffer of pending notifications */
+  notif_slot_t _notifQueue[NOTIF_QUEUE_SIZE];
+  uint8_t _notifHead = 0;
+  uint8_t _notifCount = 0;
+#if defined(WAVE_SEND_COALESCE)
+  /* Ring buffer of messages for the controller */
+  send_slot_t _sendQueue[SEND_QUEUE_SIZE];
+  uint8_t _sendHead = 0;
+  uint8_t _sendCount = 0;
+#endif
+#if defined(WAVE_TIME_SYNC)
+  /* Last network time received, on local clock */
+  bool _timeSynced = false;
+  uint32_t _timeLocal;
+  uint32_t _timeNetwork;
+  uint32_t _timeEpoch = 0;
+  uint32_t _timeEpochTime;
+  int32_t _timeDrift = 0;
+  uint8_t _timeSamples = 0;
+  /* Scheduled commands waiting for their time */
+  timed_msg_t _fireQueue[TIME_FIRE_QUEUE];
+  uint8_t _fireCount = 0;
+#endif
+#if defined(WAVE_SIGNING)
+  /* Network key, same on all nodes */
+  uint64_t _signKey[2];
+  /* Nothing is signed nor accepted before setSigningKey() */
+  bool _signKeyed = false;
+  sign_peer_t _signPeers[SIGN_MAX_PEERS];
+  sign_stats_t _signStats;
+  uint32_t _signTimer;
+  uint16_t _signCounter = 0;
+  uint8_t _signEvict = 0;
+#endif
+#if defined(WAVE_RULES)
+  /* Rules loaded by sketch or controller, checked on each value received */
+  rule_t _rules[RULES_MAX];
+#endif
+#if defined(WAVE_PRESENT_BATCH)
+  /* Presentation records waiting for presentFlush() */
+  uint8_t _presentFrame[PRESENT_FRAME_SIZE];
+  uint8_t _presentLength = 0;
+  /* Failed attempts to send the batch, and time of last one */
+  uint8_t _presentRetry = 0;
+  uint32_t _presentTimer;
+#endif
+  /* Node only keeps rows of its own groups, in groupsID order */
+  uint8_t listGroupsID[NODE_MAX_GROUPS][MAX_NODE_GROUPS];
+};
+
+/**
+ * \struct repeater_state_t
+ * \brief State of a repeater, which only relays for its children
+ */
+struct repeater_state_t{
+  /* Last check of the parent */
+  uint32_t _checkTimer = 0;
+};
+
+/**
+ * \struct MasterPolicy
+ * \brief Role of node 0: gateway of the controller, answers joins and fans
+ * out group commands
+ */
+struct MasterPolicy{
+  typedef master_state_t state_t;
+  static constexpr bool master = true;
+};
+
+/**
+ * \struct StandbyPolicy
+ * \brief Master waiting as WAVE_STANDBY_ID until node 0 is lost
+ */
+struct StandbyPolicy : MasterPolicy{
+  typedef standby_state_t state_t;
+};
 
-class RF24Wave
+/**
+ * \struct NodePolicy
+ * \brief Role of a sensor node, member of its groups
+ */
+struct NodePolicy{
+  typedef node_state_t state_t;
+  static constexpr bool master = false;
+};
+
+/**
+ * \struct RepeaterPolicy
+ * \brief Role of a relay, in no group, extending the mesh for its children
+ */
+struct RepeaterPolicy{
+  typedef repeater_state_t state_t;
+  static constexpr bool master = false;
+};
+
+template <class Role>
+class RF24WaveCore
 {
  /**@}*/
  /**
@@ -160,12 +1496,15 @@ class RF24Wave
      * RF24Mesh mesh(radio,network);
      * RF24Wave wave(network, mesh)
      * @endcode
+     * RF24Wave is the core of the role the sketch is built for (WAVE_MASTER,
+     * WAVE_STANDBY, WAVE_REPEATER, else node), RF24WaveCore<NodePolicy>...
+     * name a role whatever the build flags.
      * @param _network The underlying network instance
      * @param _mesh The underlying mesh instance
      * @param NodeID The NodeID associated to node (0 for master)
      * @param groups Tab of groups associated to this node (null for master)
      */
-    RF24Wave(RF24& _radio, RF24Network& _network, RF24Mesh& _mesh, uint8_t NodeID=0, uint8_t *groups=NULL);
+    RF24WaveCore(RF24& _radio, RF24Network& _network, RF24Mesh& _mesh, uint8_t NodeID=0, uint8_t *groups=NULL);
 
 /***************************** Common functions *****************************/
     void begin();
@@ -176,38 +1515,188 @@ class RF24Wave
     void addListAssociations(info_node_t data);
     void addAssociation(uint8_t NID, uint8_t GID);
     bool isPresent(uint8_t NID, uint8_t GID);
+#if defined(WAVE_LIVENESS)
+    bool removeAssociation(uint8_t NID, uint8_t GID);
+#endif
+    uint8_t *groupRow(uint8_t GID);
     void printAssociation(info_node_t data);
+    void printLine(const char *format, ...);
     uint8_t countGroups(uint8_t *groups);
     MyMessage& build(MyMessage &msg, const uint8_t NID, const uint8_t destID, const uint8_t childID,
                       const uint8_t command, const uint8_t type, const bool ack);
     uint8_t protocolH2i(char c);
     bool protocolParse(MyMessage &message, char *inputString);
     char* protocolFormat(MyMessage &message);
+#if defined(WAVE_OTA)
+    uint8_t otaStatus();
+    void processOta();
+    void receiveOta(firmware_msg_t &msg);
+    void sendOta(uint8_t command, uint16_t block, uint8_t destID);
+    static uint16_t crc16Update(uint16_t crc, uint8_t data);
+#endif
+    bool meshWrite(const void *data, uint8_t type, size_t size, uint8_t NID = 0);
+#if defined(WAVE_TIME_SYNC)
+    uint32_t networkTime();
+    uint32_t networkEpoch();
+#endif
+#if defined(WAVE_CHANNEL_SCAN)
+    uint8_t surveyChannels();
+#endif
+#if defined(WAVE_CHANNEL_SCAN) || defined(WAVE_RATE_ADAPT)
+    bool scanMesh();
+#endif
+#if defined(WAVE_RATE_ADAPT)
+    uint8_t dataRateLevel();
+    void adaptRate();
+    void sendRate(uint8_t level);
+    void receiveRate(uint8_t rate);
+#endif
+#if defined(WAVE_LINK_QUALITY)
+    const link_stats_t* linkStats(uint8_t NID);
+    uint8_t linkPALevel();
+    uint8_t linkRetries();
+    link_stats_t* findLink(uint8_t NID);
+    void recordReceive(RF24NetworkHeader &header);
+    void linkReset();
+    void linkBegin();
+    void applyLink();
+    void adaptLink();
+#endif
+#if defined(WAVE_STREAM)
+    bool streamSend(uint8_t destID, const void *data, uint16_t length);
+    void streamReceive(void *buffer, uint16_t size);
+    void streamReceive(stream_sink_t sink);
+    uint8_t streamSendStatus();
+    uint8_t streamReceiveStatus();
+    uint16_t streamReceivedLength();
+    uint32_t streamThroughput();
+    const stream_stats_t& streamStats();
+    void processStream();
+    void receiveStreamChunk(stream_chunk_t &chunk, uint8_t size);
+    void receiveStreamAck(stream_ack_t &ack);
+    void sendStreamAck();
+#endif
 
 
-#if !defined(WAVE_MASTER)
 /***************************** Node functions *******************************/
+    uint32_t joinBackoff(uint8_t attempt);
+    uint32_t entropySeed();
     void connect();
+    bool isAssociated();
+    bool isSynchronized();
     bool requestAssociations();
     bool confirmAssociations();
     void synchronizeAssociations();
     void requestSynchronize();
     void confirmSynchronize();
-    void receiveSynchronizedList(send_list_t msg);
+    void receiveSynchronizedList(const send_list_t &msg);
     void broadcastNotifications(MyMessage &message);
-    void sendNotifications(mysensor_sensor tSensor, mysensor_data tValue,
-      mysensor_payload tPayload, int16_t payload);
-    void sendNotifications(mysensor_sensor tSensor, mysensor_data tValue,
-      mysensor_payload tPayload, int32_t payload);
+    /**
+     * Queue a notification for all nodes sharing a group with this node.
+     * The payload (int16_t, int32_t, float, bool...) is copied in its native
+     * binary form, without ASCII formatting, and sent by listen().
+     * A pending notification with the same child and type is overwritten
+     * by the newest value.
+     * @param tSensor Child ID of the sensor
+     * @param tValue Type of data
+     * @param tPayload Type of payload matching T
+     * @param payload Value to send
+     * @return false if the queue is full
+     */
+    template <typename T>
+    bool sendNotifications(mysensor_sensor tSensor, mysensor_data tValue,
+      mysensor_payload tPayload, T payload)
+    {
+      static_assert(sizeof(T) <= MAX_PAYLOAD, "Payload too large for a notification");
+      MyMessage *msg = queueNotification(tSensor, tValue);
+      if(!msg){
+        return false;
+      }
+      memcpy(msg->data, &payload, sizeof(T));
+      mSetLength((*msg), sizeof(T));
+      mSetPayloadType((*msg), tPayload);
+      return true;
+    }
+    MyMessage* queueNotification(uint8_t childID, uint8_t type);
+    void processNotifications();
+#if defined(WAVE_OTA)
+    void otaBegin(uint16_t version, firmware_writer_t writer, firmware_reader_t reader);
+    void storeFirmwareBlock(uint16_t block, const uint8_t *data);
+    void requestFirmwareBlocks();
+    bool verifyFirmware();
+#endif
     void printUpdate(update_msg_t data);
     void addNodeToBroadcastList(uint8_t NID);
     void createBroadcastList();
+#if defined(WAVE_SEND_COALESCE)
+    /**
+     * Queue a message for the controller, sent by listen(). Until it is
+     * sent, a newer value of the same child and type replaces it.
+     * @param message Message to send, command is set to C_SET
+     * @param event true to send every occurrence, in order
+     * @return false if the queue is full
+     */
+    bool send(MyMessage &message, bool event = false);
+    void processSends();
+#else
     void send(MyMessage &message);
+#endif
     void sendSketchInfo(const char *name, const char *version);
     void present(const uint8_t childId, const uint8_t sensorType, const char *description = "");
     void sendMyMessage(MyMessage &message, uint8_t destID);
+#if defined(WAVE_PRESENT_BATCH)
+    void presentAdd(MyMessage &message);
+    bool presentFlush();
+    bool presentWait();
+#endif
+#if defined(WAVE_TIME_SYNC)
+    bool sendStamped(MyMessage &message);
+    bool timeSynced();
+    int32_t timeDrift();
+    void receiveTime(const time_msg_t &msg);
+    void queueFire(const timed_msg_t &fire);
+    void processFires();
+#endif
+    void renewAddress();
+    template <uint8_t N>
+    void setHandlers(const sensor_route_t (&routes)[N])
+    {
+      setHandlers(routes, N);
+    }
+    void setHandlers(const sensor_route_t *routes, uint8_t count);
+    sensor_handler_t findHandler(const MyMessage &message);
+    void dispatch(const MyMessage &message);
+    void receiveUpdateGroup(const update_group_msg_t &data);
+#if defined(WAVE_LIVENESS)
+    void leave();
+    void receiveLeave(update_msg_t data);
+    void removeNodeFromBroadcastList(uint8_t NID);
+    void sendHeartbeatResponse();
+#endif
+#if defined(WAVE_SIGNING)
+    void setSigningKey(const uint8_t *key);
+    const sign_stats_t& signStats();
+    static uint64_t signMac(const uint64_t *key, uint64_t prefix, const uint8_t *data, uint8_t length);
+    static uint8_t signSize(uint8_t length);
+    sign_peer_t* findSignPeer(uint8_t NID, bool create);
+    bool requestNonces(uint8_t NID);
+    void issueNonces(uint8_t NID);
+    void receiveNonces(const nonce_msg_t &msg);
+    uint8_t signFrame(MyMessage &message, uint8_t NID, uint8_t *frame);
+    bool verifyFrame(const uint8_t *frame, uint8_t size, MyMessage &message);
+    void processSigning();
+#endif
+#if defined(WAVE_RULES)
+    bool setRule(uint8_t index, const rule_t &rule);
+    void clearRules();
+    const rule_t* rule(uint8_t index);
+    void receiveRule(const MyMessage &message);
+    static int32_t ruleValue(const MyMessage &message);
+    bool matchRule(const rule_t &rule, const MyMessage &message, int32_t value);
+    void setRuleValue(MyMessage &message, const rule_t &rule, const MyMessage &trigger);
+    void applyRules(const MyMessage &message);
+#endif
 
-#else
 /***************************** Master functions *****************************/
     bool checkAssociations(info_node_t *data);
     bool checkGroup(uint8_t ID, uint8_t group);
@@ -215,41 +1704,229 @@ class RF24Wave
     bool sendUpdateGroup(uint8_t NID, uint8_t GID, uint8_t *listNID);
     void sendSynchronizedList(info_node_t msg);
     void printNetwork();
+#if defined(WAVE_JOIN_BATCH)
+    void queueJoin(const info_node_t &info);
+    void processJoins();
+#endif
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+    void resetHeard();
+    void markAlive(RF24NetworkHeader &header);
+    void checkLiveness();
+#endif
+#if defined(WAVE_LIVENESS)
+    void evictNode(uint8_t NID);
+    void forgetMember(uint8_t NID, uint8_t GID);
+    bool sendLeaveGroup(uint8_t NID, uint8_t GID, uint8_t *listNID);
+#endif
+#if defined(WAVE_ADMISSION)
+    const admit_state_t* admitStats(uint8_t NID);
+    const admit_counters_t& admitCounters();
+    admit_state_t* findAdmit(uint8_t NID);
+    admit_state_t* admitRequest(RF24NetworkHeader &header, uint8_t NID, uint8_t cls);
+    bool answerCached(admit_state_t *admit, info_node_t &info);
+    void cacheAnswer(admit_state_t *admit, const info_node_t &info);
+    void admitBegin();
+#endif
     MyMessage& buildGw(MyMessage &msg, const uint8_t type);
     void gatewayTransportSend(MyMessage &message);
+    void gatewayTransportWrite(const char *data);
     void gatewayTransportInit();
     bool gatewayTransportAvailable();
+#if defined(WAVE_GATEWAY_TCP)
+    void gatewayTransportAccept();
+    void gatewayClientWrite(uint8_t i, const char *data);
+#elif defined(WAVE_TX_QUEUE)
+    void gatewayTransportFlush();
+    const tx_queue_stats_t& txQueueStats();
+#endif
     MyMessage& gatewayTransportReceive();
     void transmitMyMessage(MyMessage &message, uint8_t destID);
+#if defined(WAVE_PRESENT_BATCH)
+    void presentExpand(const uint8_t *frame, uint8_t size);
+#endif
+#if defined(WAVE_TIME_SYNC)
+    bool queueGroupCommand(MyMessage &message, uint32_t fireAt = 0);
+    void sendTime(uint8_t NID);
+    void processTime();
+    void receiveEpoch(uint32_t seconds);
+    uint32_t fireTime(const MyMessage &message);
+    bool sendFire(group_cmd_t *cmd, uint8_t NID);
+    void forwardStamped(timed_msg_t &stamped);
+#else
+    bool queueGroupCommand(MyMessage &message);
+#endif
+#if defined(WAVE_RULES)
+    void sendRule(uint8_t NID, uint8_t index, const rule_t &rule);
+#endif
+#if defined(WAVE_SNAPSHOT)
+    /**
+     * State of the node at index of mesh address list.
+     * @param index From 0, one per node with an address
+     * @param node Filled with the state of the node
+     * @return false past the last node
+     */
+    bool snapshotNode(uint8_t index, snapshot_node_t &node);
+    void sendSnapshot();
+#endif
+#if defined(WAVE_VALUE_CACHE)
+    const value_cache_stats_t& valueCacheStats();
+    void cacheValue(char *line);
+    bool answerFromCache(MyMessage &message);
+#endif
+#if defined(WAVE_CAPTURE)
+    void setCaptureSink(capture_sink_t sink);
+    const capture_stats_t& captureStats();
+    uint16_t captureRead(uint8_t *buffer, uint16_t size);
+    static void captureHeader(uint8_t *record, uint32_t time, uint16_t from, uint8_t NID, uint8_t type, uint8_t size);
+    void captureRecord(const uint8_t *record, uint8_t length);
+    void captureFrame(RF24NetworkHeader &header);
+#endif
+    void processGroupCommands();
+    void reportGroupCommand(MyMessage &message, uint8_t NID, bool delivered);
+#if defined(WAVE_OTA)
+    bool otaStart(uint8_t GID, uint16_t version, uint16_t blocks, uint16_t crc, firmware_reader_t reader);
+    bool serveOta();
+    void endOta();
+#endif
+#if defined(WAVE_STANDBY_ID)
+    void replicateAssociations();
+    void sendHeartbeat();
 
+/***************************** Standby functions ****************************/
+    void listenStandby();
+    bool masterLost();
+    void mirrorAddress(heartbeat_msg_t data);
+    void takeover();
+    bool isStandby();
 #endif
 
   private:
+    /* Code of one role, selected by the tag of Role */
+    void initRole(uint8_t *groups, MasterPolicy);
+    void initRole(uint8_t *groups, NodePolicy);
+    void initRole(uint8_t *groups, RepeaterPolicy);
+    bool prepareBegin(MasterPolicy);
+    bool prepareBegin(NodePolicy);
+    bool prepareBegin(RepeaterPolicy);
+    void joinMesh(MasterPolicy);
+    void joinMesh(NodePolicy);
+    void joinMesh(RepeaterPolicy);
+    void beginRole(MasterPolicy);
+    void beginRole(NodePolicy);
+    void beginRole(RepeaterPolicy);
+    void announce(MasterPolicy);
+    void updateMesh();
+    bool updateRole(MasterPolicy);
+    bool updateRole(NodePolicy);
+    bool updateRole(RepeaterPolicy);
+    bool receiveRole(RF24NetworkHeader &header, MasterPolicy);
+    bool receiveRole(RF24NetworkHeader &header, NodePolicy);
+    bool receiveRole(RF24NetworkHeader &header, RepeaterPolicy);
+    void processRole(MasterPolicy);
+    void processRole(NodePolicy);
+    void processRole(RepeaterPolicy);
+    uint8_t *groupRow(uint8_t GID, MasterPolicy);
+    uint8_t *groupRow(uint8_t GID, NodePolicy);
+    uint8_t rowGroup(uint8_t i, MasterPolicy);
+    uint8_t rowGroup(uint8_t i, NodePolicy);
+    void assocChanged(MasterPolicy);
+    void assocChanged(NodePolicy);
+    void slotAdded(uint8_t GID, uint8_t slot, MasterPolicy);
+    void slotAdded(uint8_t GID, uint8_t slot, NodePolicy);
+#if defined(WAVE_LIVENESS)
+    void slotRemoved(uint8_t NID, uint8_t GID, uint8_t slot, MasterPolicy);
+    void slotRemoved(uint8_t NID, uint8_t GID, uint8_t slot, NodePolicy);
+#endif
+    void writeLine(const char *line, MasterPolicy);
+    void writeLine(const char *line, NodePolicy);
+    void writeLine(const char *line, RepeaterPolicy);
+    bool wanted(MyMessage &message, uint8_t command, MasterPolicy);
+    bool wanted(MyMessage &message, uint8_t command, NodePolicy);
+#if defined(WAVE_OTA)
+    void processOta(MasterPolicy);
+    void processOta(NodePolicy);
+    void receiveOta(firmware_msg_t &msg, MasterPolicy);
+    void receiveOta(firmware_msg_t &msg, NodePolicy);
+#endif
+#if defined(WAVE_RATE_ADAPT)
+    void writeDone(bool send, MasterPolicy);
+    void writeDone(bool send, NodePolicy);
+    void writeDone(bool send, RepeaterPolicy);
+#endif
+#if defined(WAVE_TIME_SYNC)
+    uint32_t networkTime(MasterPolicy);
+    uint32_t networkTime(NodePolicy);
+    uint32_t networkEpoch(MasterPolicy);
+    uint32_t networkEpoch(NodePolicy);
+#endif
+#if defined(WAVE_STANDBY_ID)
+    bool prepareBegin(StandbyPolicy);
+    void joinMesh(StandbyPolicy);
+    void announce(StandbyPolicy);
+    bool updateRole(StandbyPolicy);
+#endif
+
     RF24& radio;
     RF24Network& network;
     RF24Mesh& mesh;
     // global variables
     MyMessage _msgTmp;
-    char _fmtBuffer[MY_GATEWAY_MAX_SEND_LENGTH];
-    char _convBuffer[MAX_PAYLOAD*2+1];
-    info_node_t info_payload;
-    update_msg_t update_payload;
-    send_list_t list_payload;
-
-#if !defined(WAVE_MASTER)
-    bool associated = false;
-    bool synchronized = false;
-    /* Struct to stock different group ID proper to this node */
-    uint8_t groupsID[MAX_GROUPS];
-    broadcast_list_t *headBroadcastList = NULL;
-    uint8_t lengthBroadcastList = 0;
-#else
-    uint8_t _serialInputPos;
+    wave_scratch_t _scratch;
+#if defined(WAVE_OTA)
+    ota_state_t _ota;
+    firmware_msg_t _otaFrame;
+    firmware_reader_t _otaReader = NULL;
+#endif
+#if defined(WAVE_STREAM)
+    stream_state_t _streamTx;
+    stream_state_t _streamRx;
+    stream_stats_t _streamStats;
+    const uint8_t *_streamData = NULL;
+    uint8_t *_streamBuffer = NULL;
+    uint16_t _streamBufferSize = 0;
+    stream_sink_t _streamSink = NULL;
+    uint8_t _streamID = 0;
+#endif
+#if defined(WAVE_LINK_QUALITY)
+    link_stats_t _links[LINK_MAX_NODES];
+    uint8_t _linkPA = LINK_PA_MAX;
+    uint8_t _linkRetries = LINK_RETRY_MAX;
+    /* Added to RF24Network staggered retry delay */
+    uint8_t _linkDelay = 0;
+    uint32_t _linkTimer = 0;
+    /* RPD sampled when listen() took frames off the radio */
+    bool _linkStrong = false;
+#endif
+#if defined(WAVE_RATE_ADAPT)
+    /* Data rates a network may use, slowest first */
+    static constexpr rf24_datarate_e dataRates[WAVE_SCAN_RATES] = {RF24_250KBPS, RF24_1MBPS, RF24_2MBPS};
+    /* Index of network data rate, slowest first */
+    uint8_t _rateLevel = 0;
 #endif
     uint8_t nodeID;
-    /* Matrix to stock nodeID for each different groupID */
-    uint8_t listGroupsID[MAX_GROUPS][MAX_NODE_GROUPS];
+    /* State of the role, only its own code uses it */
+    typename Role::state_t _role;
     uint32_t lastTimer;
 };
 
+}
+
+#include "RF24WaveImpl.h"
+
+/* Core of the role this unit is built for */
+#if defined(WAVE_REPEATER)
+typedef RF24WaveCore<RepeaterPolicy> RF24Wave;
+#elif defined(WAVE_STANDBY)
+typedef RF24WaveCore<StandbyPolicy> RF24Wave;
+#elif defined(WAVE_MASTER)
+typedef RF24WaveCore<MasterPolicy> RF24Wave;
+#else
+typedef RF24WaveCore<NodePolicy> RF24Wave;
+#endif
+
+#if defined(WAVE_RAM_BUDGET)
+/* Build fails when this role needs more than budget given in build flags */
+static_assert(sizeof(RF24Wave) <= WAVE_RAM_BUDGET, "RF24Wave exceeds WAVE_RAM_BUDGET");
+#endif
+
 #endif
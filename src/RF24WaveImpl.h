@@ -0,0 +1,4572 @@
+/**
+ * \file RF24WaveImpl.h
+ * \brief Class definition for RF24WaveCore, included by RF24Wave.h
+ * \author LAMBRECHT.A
+ * \version 0.5
+ * \date 01-01-2017
+ *
+ * Implementation of Z-Wave protocol with nRF24l01
+ *
+ * Members are templates of the role policy: a unit only compiles the code
+ * its role calls. Code that differs between roles is in overloads taking
+ * the policy tag, code of one role only uses the state of that role.
+ *
+ */
+
+namespace WAVE_NS {
+
+#if defined(WAVE_RATE_ADAPT)
+template <class Role>
+constexpr rf24_datarate_e RF24WaveCore<Role>::dataRates[];
+#endif
+
+/***************************** Constructor **********************************/
+template <class Role>
+RF24WaveCore<Role>::RF24WaveCore(RF24& _radio, RF24Network& _network, RF24Mesh& _mesh, uint8_t NodeID, uint8_t *groups):
+radio(_radio), network(_network), mesh(_mesh)
+{
+  nodeID = NodeID;
+  initRole(groups, Role());
+  memset(&_scratch, 0, sizeof(wave_scratch_t));
+#if defined(WAVE_LINK_QUALITY)
+  /* Links are counted before begin(), which starts again from radio PA */
+  linkReset();
+#endif
+#if defined(WAVE_OTA)
+  memset(&_ota, 0, sizeof(ota_state_t));
+#endif
+#if defined(WAVE_STREAM)
+  memset(&_streamTx, 0, sizeof(stream_state_t));
+  memset(&_streamRx, 0, sizeof(stream_state_t));
+  memset(&_streamStats, 0, sizeof(stream_stats_t));
+#endif
+
+};
+
+template <class Role>
+void RF24WaveCore<Role>::initRole(uint8_t *groups, MasterPolicy)
+{
+  (void)groups;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::initRole(uint8_t *groups, NodePolicy)
+{
+  uint8_t i, length;
+  length = countGroups(groups);
+  for(i=0; i<MAX_GROUPS; i++){
+    _role.groupsID[i] = 0;
+  }
+  /* Groups beyond NODE_MAX_GROUPS have no row: refused by begin() */
+  _role._groupsRefused = length > NODE_MAX_GROUPS;
+  if(groups != NULL && !_role._groupsRefused){
+    for(i=0; i<length; i++){
+      _role.groupsID[i] = groups[i];
+    }
+  }
+#if defined(WAVE_RULES)
+  /* Sketch may set rules before begin() */
+  memset(_role._rules, 0, sizeof(_role._rules));
+#endif
+#if defined(WAVE_SIGNING)
+  memset(_role._signKey, 0, sizeof(_role._signKey));
+  memset(_role._signPeers, 0, sizeof(_role._signPeers));
+  memset(&_role._signStats, 0, sizeof(sign_stats_t));
+  _role._signTimer = 0;
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::initRole(uint8_t *groups, RepeaterPolicy)
+{
+  /* Repeater is in no group */
+  (void)groups;
+}
+
+
+
+/***************************** Common functions *****************************/
+
+template <class Role>
+void RF24WaveCore<Role>::begin()
+{
+  if(!prepareBegin(Role())){
+    return;
+  }
+  mesh.setNodeID(nodeID);
+  nodeID = mesh.getNodeID();
+  P_DEBUG("Connecting to the mesh...");
+  joinMesh(Role());
+  //mesh.begin();
+#if defined(AMPLIFICATOR)
+  radio.setPALevel(RF24_PA_LOW);
+#endif
+#if defined(WAVE_LINK_QUALITY)
+  linkBegin();
+#endif
+#if defined(WAVE_RATE_ADAPT)
+  _rateLevel = dataRateLevel();
+#endif
+  lastTimer = millis();
+  P_DEBUG("Connecting to the wave...");
+  beginRole(Role());
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::prepareBegin(MasterPolicy)
+{
+#if defined(WAVE_TX_QUEUE) && !defined(WAVE_GATEWAY_TCP)
+  /* Queue is ready before first line, P_DEBUG and surveyChannels() print */
+  memset(&_role._txStats, 0, sizeof(tx_queue_stats_t));
+  _role._txHead = 0;
+  _role._txCount = 0;
+#endif
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::prepareBegin(NodePolicy)
+{
+  if(_role._groupsRefused){
+    Serial.print(F("[begin] ERROR: More groups than NODE_MAX_GROUPS "));
+    Serial.println(NODE_MAX_GROUPS);
+    return false;
+  }
+#if defined(WAVE_SIGNING)
+  if(!_role._signKeyed){
+    Serial.println(F("[begin] ERROR: No signing key, notifications are not sent nor accepted"));
+  }
+#endif
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::prepareBegin(RepeaterPolicy)
+{
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::joinMesh(MasterPolicy)
+{
+  mesh.begin(WAVE_CHANNEL, WAVE_DATA_RATE);
+#if defined(WAVE_CHANNEL_SCAN)
+  mesh.setChannel(surveyChannels());
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::joinMesh(NodePolicy)
+{
+#if defined(WAVE_CHANNEL_SCAN) || defined(WAVE_RATE_ADAPT)
+  if(!mesh.begin(WAVE_CHANNEL, WAVE_DATA_RATE, CHANNEL_SCAN_TIMEOUT)){
+    scanMesh();
+  }
+#else
+  mesh.begin(WAVE_CHANNEL, WAVE_DATA_RATE);
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::joinMesh(RepeaterPolicy)
+{
+  joinMesh(NodePolicy());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::beginRole(MasterPolicy)
+{
+#if defined(WAVE_RATE_ADAPT)
+  _role._rateTimer = millis();
+#endif
+#if defined(WAVE_ADMISSION)
+  admitBegin();
+#endif
+#if defined(WAVE_VALUE_CACHE)
+  memset(&_role._valueCacheStats, 0, sizeof(value_cache_stats_t));
+#endif
+#if defined(WAVE_CAPTURE)
+  memset(&_role._captureStats, 0, sizeof(capture_stats_t));
+#endif
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+  resetHeard();
+#endif
+#if defined(WAVE_TIME_SYNC)
+  _role._timeTimer = millis();
+#endif
+  resetListGroup();
+  announce(Role());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::beginRole(NodePolicy)
+{
+  resetListGroup();
+  connect();
+  synchronizeAssociations();
+}
+
+template <class Role>
+void RF24WaveCore<Role>::beginRole(RepeaterPolicy)
+{
+  _role._checkTimer = millis();
+}
+
+template <class Role>
+void RF24WaveCore<Role>::announce(MasterPolicy)
+{
+  gatewayTransportInit();
+#if defined(WAVE_TIME_SYNC)
+  /* Controller answers with its time in seconds */
+  gatewayTransportSend(buildGw(_msgTmp, I_TIME));
+#endif
+#if defined(WAVE_STANDBY_ID)
+  _role._lastHeartbeat = millis();
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::listen(){
+  if(!updateRole(Role())){
+    return;
+  }
+  if(network.available()){
+    RF24NetworkHeader header;
+    network.peek(header);
+#if defined(WAVE_LINK_QUALITY)
+    recordReceive(header);
+#endif
+    if(!receiveRole(header, Role())){
+      switch(header.type){
+#if defined(WAVE_STREAM)
+        case STREAM_MSG_T:
+          {
+            stream_chunk_t chunk;
+            uint8_t size = network.read(header, &chunk, sizeof(stream_chunk_t));
+            receiveStreamChunk(chunk, size);
+          }
+          break;
+        case STREAM_ACK_MSG_T:
+          {
+            stream_ack_t ack;
+            network.read(header, &ack, sizeof(stream_ack_t));
+            receiveStreamAck(ack);
+          }
+          break;
+#endif
+        default:
+          /* Unknown frame would block the queue, drop it */
+          network.read(header, 0, 0);
+          break;
+      }
+    }
+  }
+
+#if defined(WAVE_STREAM)
+  processStream();
+#endif
+#if defined(WAVE_LINK_QUALITY)
+  adaptLink();
+#endif
+  processRole(Role());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::updateMesh()
+{
+#if defined(WAVE_LINK_QUALITY)
+  /* RPD latches on the frame just received, later ones would overwrite it */
+  if(mesh.update()){
+    _linkStrong = radio.testRPD();
+  }
+#else
+  mesh.update();
+#endif
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::updateRole(MasterPolicy)
+{
+  updateMesh();
+  mesh.DHCP();
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::updateRole(NodePolicy)
+{
+  if(_role._groupsRefused){
+    return false;
+  }
+  updateMesh();
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::updateRole(RepeaterPolicy)
+{
+  updateMesh();
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::receiveRole(RF24NetworkHeader &header, MasterPolicy)
+{
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+  markAlive(header);
+#endif
+#if defined(WAVE_CAPTURE)
+  captureFrame(header);
+#endif
+  switch(header.type){
+    case MY_MESSAGE_T:
+      P_DEBUG("[listen] MY_MESSAGE_T")
+      network.read(header, _scratch.format.buffer, MY_GATEWAY_MAX_SEND_LENGTH);
+      gatewayTransportWrite(_scratch.format.buffer);
+#if defined(WAVE_VALUE_CACHE)
+      cacheValue(_scratch.format.buffer);
+#endif
+      break;
+#if defined(WAVE_OTA)
+    case OTA_MSG_T:
+      memset(&_otaFrame, 0, sizeof(firmware_msg_t));
+      network.read(header, &_otaFrame, sizeof(firmware_msg_t));
+      receiveOta(_otaFrame);
+      break;
+#endif
+    case CONNECT_MSG_T:
+      {
+#if !defined(WAVE_JOIN_BATCH)
+        bool changed;
+#endif
+#if defined(WAVE_ADMISSION)
+        admit_state_t *admit;
+#endif
+        {
+          ScratchLease<info_node_t> info(_scratch);
+          network.read(header, &info.data, sizeof(info_node_t));
+          F_DEBUG(printAssociation(info.data))
+#if defined(WAVE_ADMISSION)
+          /* Flooding node is dropped, repeated request answered as before */
+          admit = admitRequest(header, info.data.nodeID, ADMIT_CONNECT);
+          if(!admit || answerCached(admit, info.data)){
+            break;
+          }
+#endif
+#if defined(WAVE_JOIN_BATCH)
+          /* Answered with the rest of its batch by processJoins() */
+          queueJoin(info.data);
+#else
+          changed = checkAssociations(&info.data);
+          if(changed){
+            P_DEBUG("[listen] broadcastAssociations")
+            broadcastAssociations(info.data);
+            P_DEBUG("[listen] addListAssociations")
+            addListAssociations(info.data);
+            F_DEBUG(printAssociations())
+          }
+#if defined(WAVE_ADMISSION)
+          cacheAnswer(admit, info.data);
+#endif
+#endif
+        }
+#if defined(WAVE_STANDBY_ID) && !defined(WAVE_JOIN_BATCH)
+        /* Replication leases list, once info is released */
+        if(changed){
+          replicateAssociations();
+        }
+#endif
+      }
+      break;
+    case SYNCHRONIZE_MSG_T:
+      {
+        /* Kept on stack, sendSynchronizedList leases the arena */
+        info_node_t info;
+        memset(&info, 0, sizeof(info_node_t));
+        P_DEBUG("[listen] SYNCHRONIZE_MSG_T")
+        network.read(header, &info, sizeof(info_node_t));
+#if defined(WAVE_ADMISSION)
+        if(!admitRequest(header, info.nodeID, ADMIT_SYNCHRONIZE)){
+          break;
+        }
+#endif
+        P_DEBUG("[listen] sendSynchronizedList")
+        sendSynchronizedList(info);
+#if defined(WAVE_TIME_SYNC)
+        /* Node just joined, it should not wait for next round */
+        sendTime(info.nodeID);
+#endif
+      }
+      break;
+#if defined(WAVE_TIME_SYNC)
+    case STAMPED_MSG_T:
+      {
+        timed_msg_t stamped;
+        network.read(header, &stamped, sizeof(timed_msg_t));
+        forwardStamped(stamped);
+      }
+      break;
+#endif
+#if defined(WAVE_LIVENESS)
+    case LEAVE_MSG_T:
+      {
+        update_msg_t leave;
+        int16_t sender = mesh.getNodeID(header.from_node);
+        network.read(header, &leave, sizeof(update_msg_t));
+        /* A node may only remove itself */
+        if(sender == leave.nodeID){
+          evictNode(leave.nodeID);
+        }
+      }
+      break;
+#endif
+#if defined(WAVE_STANDBY_ID)
+    case STANDBY_MSG_T:
+      P_DEBUG("[listen] STANDBY_MSG_T")
+      network.read(header, 0, 0);
+      replicateAssociations();
+      break;
+#endif
+#if defined(WAVE_PRESENT_BATCH)
+    case PRESENT_MSG_T:
+      P_DEBUG("[listen] PRESENT_MSG_T")
+      {
+        uint8_t frame[PRESENT_FRAME_SIZE];
+        uint8_t size = network.read(header, frame, sizeof(frame));
+        presentExpand(frame, size);
+      }
+      break;
+#endif
+    default:
+      return false;
+  }
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::receiveRole(RF24NetworkHeader &header, NodePolicy)
+{
+  switch(header.type){
+    case MY_MESSAGE_T:
+      P_DEBUG("[listen] MY_MESSAGE_T")
+      network.read(header, _scratch.format.buffer, MY_GATEWAY_MAX_SEND_LENGTH);
+      Serial.print(_scratch.format.buffer);
+      if(protocolParse(_msgTmp, _scratch.format.buffer)){
+        P_DEBUG("[MY_MESSAGE_T] parse ok !")
+#if defined(WAVE_LIVENESS)
+        if(mGetCommand(_msgTmp) == C_INTERNAL && _msgTmp.type == I_HEARTBEAT_REQUEST){
+          sendHeartbeatResponse();
+          break;
+        }
+#endif
+#if defined(WAVE_RULES)
+        if(mGetCommand(_msgTmp) == C_STREAM && _msgTmp.type == RULE_STREAM_TYPE){
+          /* Rules are only taken from master */
+          if(header.from_node == 0){
+            receiveRule(_msgTmp);
+          }
+          break;
+        }
+        applyRules(_msgTmp);
+#endif
+        dispatch(_msgTmp);
+      }
+      break;
+#if defined(WAVE_OTA)
+    case OTA_MSG_T:
+      memset(&_otaFrame, 0, sizeof(firmware_msg_t));
+      network.read(header, &_otaFrame, sizeof(firmware_msg_t));
+      receiveOta(_otaFrame);
+      break;
+#endif
+    case UPDATE_MSG_T:
+      {
+        update_msg_t update;
+        memset(&update, 0, sizeof(update_msg_t));
+        network.read(header, &update, sizeof(update_msg_t));
+        printUpdate(update);
+        addAssociation(update.nodeID, update.groupID);
+        printAssociations();
+        createBroadcastList();
+      }
+      break;
+#if defined(WAVE_RATE_ADAPT)
+    case RATE_MSG_T:
+      {
+        uint8_t rate;
+        network.read(header, &rate, sizeof(rate));
+        receiveRate(rate);
+      }
+      break;
+#endif
+#if defined(WAVE_LIVENESS)
+    case LEAVE_MSG_T:
+      {
+        update_msg_t leave;
+        network.read(header, &leave, sizeof(update_msg_t));
+        receiveLeave(leave);
+      }
+      break;
+#endif
+#if defined(WAVE_TIME_SYNC)
+    case TIME_MSG_T:
+      {
+        time_msg_t time;
+        network.read(header, &time, sizeof(time_msg_t));
+        receiveTime(time);
+      }
+      break;
+#endif
+    case FIRE_MSG_T:
+      {
+        timed_msg_t fire;
+        fire.message.clear();
+        network.read(header, &fire, sizeof(timed_msg_t));
+#if defined(WAVE_TIME_SYNC)
+        queueFire(fire);
+#else
+        /* Without network time, actuate on receipt */
+        dispatch(fire.message);
+#endif
+      }
+      break;
+    case UPDATE_GROUP_MSG_T:
+      {
+        /* Sent by any master batching joins, whatever this node's flags */
+        update_group_msg_t update;
+        network.read(header, &update, sizeof(update_group_msg_t));
+        receiveUpdateGroup(update);
+      }
+      break;
+#if defined(WAVE_SIGNING)
+    case NONCE_REQUEST_MSG_T:
+      {
+        uint8_t NID;
+        int16_t sender = mesh.getNodeID(header.from_node);
+        network.read(header, &NID, sizeof(NID));
+        /* A node may only refill its own pool */
+        if(sender == NID){
+          issueNonces(NID);
+        }
+      }
+      break;
+    case NONCE_MSG_T:
+      {
+        nonce_msg_t nonces;
+        int16_t sender = mesh.getNodeID(header.from_node);
+        network.read(header, &nonces, sizeof(nonce_msg_t));
+        if(sender == nonces.nodeID){
+          receiveNonces(nonces);
+        }
+      }
+      break;
+#endif
+    case NOTIF_MSG_T:
+      P_DEBUG("[listen] NOTIF_MSG_T")
+      _msgTmp.clear();
+#if defined(WAVE_SIGNING)
+      {
+        ScratchLease<sign_scratch_t> sign(_scratch);
+        uint8_t size = network.read(header, sign.data.frame, sizeof(sign_scratch_t));
+        if(!verifyFrame(sign.data.frame, size, _msgTmp)){
+          P_DEBUG("[listen] Notification signature rejected")
+          break;
+        }
+      }
+#else
+      network.read(header, &_msgTmp, HEADER_SIZE + MAX_PAYLOAD);
+#endif
+#if defined(WAVE_RULES)
+      applyRules(_msgTmp);
+#endif
+      dispatch(_msgTmp);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::receiveRole(RF24NetworkHeader &header, RepeaterPolicy)
+{
+  /* Frames for other nodes are relayed by RF24Network, not seen here */
+#if defined(WAVE_RATE_ADAPT)
+  if(header.type == RATE_MSG_T){
+    uint8_t rate;
+    network.read(header, &rate, sizeof(rate));
+    receiveRate(rate);
+    return true;
+  }
+#endif
+  return false;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processRole(MasterPolicy)
+{
+#if defined(WAVE_OTA)
+  processOta();
+#endif
+#if defined(WAVE_RATE_ADAPT)
+  adaptRate();
+#endif
+  processGroupCommands();
+#if defined(WAVE_STANDBY_ID)
+  sendHeartbeat();
+#endif
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+  checkLiveness();
+#endif
+#if defined(WAVE_JOIN_BATCH)
+  processJoins();
+#endif
+#if defined(WAVE_TIME_SYNC)
+  processTime();
+#endif
+#if defined(WAVE_TX_QUEUE) && !defined(WAVE_GATEWAY_TCP)
+  gatewayTransportFlush();
+#endif
+
+#if defined(WAVE_SERIAL_RECEIVE)
+  if (gatewayTransportAvailable()){
+    MyMessage &message = gatewayTransportReceive();
+#if defined(WAVE_TIME_SYNC)
+    /* Fire time only applies to the next line of the same controller */
+#if defined(WAVE_GATEWAY_TCP)
+    uint32_t &pending = _role._fireAt[_role._clientFrom];
+#else
+    uint32_t &pending = _role._fireAt;
+#endif
+    uint32_t fireAt = pending;
+    pending = 0;
+#endif
+    if (IS_GROUP_ADDRESS(message.destination)) {
+#if defined(WAVE_TIME_SYNC)
+      /* Members actuate together at fireAt, on receipt without one */
+      queueGroupCommand(message, fireAt);
+#else
+      queueGroupCommand(message);
+#endif
+    } else if (message.destination != GATEWAY_ADDRESS) {
+#if defined(WAVE_VALUE_CACHE)
+      /* Node is not woken for a value it reported recently */
+      if (mGetCommand(message) != C_REQ || !answerFromCache(message)) {
+        transmitMyMessage(message, message.destination);
+      }
+#else
+      transmitMyMessage(message, message.destination);
+#endif
+#if defined(WAVE_TIME_SYNC)
+    } else if (mGetCommand(message) == C_INTERNAL && message.type == I_TIME) {
+      receiveEpoch(message.getULong());
+    } else if (mGetCommand(message) == C_STREAM && message.type == FIRE_STREAM_TYPE) {
+      pending = fireTime(message);
+#endif
+#if defined(WAVE_SNAPSHOT)
+    } else if (mGetCommand(message) == C_STREAM && message.type == SNAPSHOT_STREAM_TYPE) {
+      sendSnapshot();
+#endif
+    }
+  }
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processRole(NodePolicy)
+{
+#if defined(WAVE_OTA)
+  processOta();
+#endif
+#if defined(WAVE_PRESENT_BATCH)
+  presentFlush();
+#endif
+#if defined(WAVE_SEND_COALESCE)
+  processSends();
+#endif
+  processNotifications();
+#if defined(WAVE_SIGNING)
+  processSigning();
+#endif
+#if defined(WAVE_TIME_SYNC)
+  processFires();
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processRole(RepeaterPolicy)
+{
+  /* Repeater has no traffic of its own to notice a lost parent */
+  if(millis() - _role._checkTimer >= REPEATER_CHECK_DELAY){
+    _role._checkTimer = millis();
+    if(!mesh.checkConnection()){
+      renewAddress();
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::resetListGroup(){
+  /* Init matrix */
+  memset(_role.listGroupsID, 0, sizeof(_role.listGroupsID));
+  assocChanged(Role());
+}
+
+template <class Role>
+uint8_t *RF24WaveCore<Role>::groupRow(uint8_t GID)
+{
+  return groupRow(GID, Role());
+}
+
+template <class Role>
+uint8_t *RF24WaveCore<Role>::groupRow(uint8_t GID, MasterPolicy)
+{
+  if(GID > 0 && GID <= MAX_GROUPS){
+    return _role.listGroupsID[GID-1];
+  }
+  return NULL;
+}
+
+template <class Role>
+uint8_t *RF24WaveCore<Role>::groupRow(uint8_t GID, NodePolicy)
+{
+  uint8_t i;
+  if(GID > 0){
+    for(i=0; i<NODE_MAX_GROUPS; i++){
+      if(_role.groupsID[i] == GID){
+        return _role.listGroupsID[i];
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Row i of listGroupsID is for this group, 0 if unused */
+template <class Role>
+uint8_t RF24WaveCore<Role>::rowGroup(uint8_t i, MasterPolicy)
+{
+  return i + 1;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::rowGroup(uint8_t i, NodePolicy)
+{
+  return _role.groupsID[i];
+}
+
+/* Cached answers of master are stale once an association changed */
+template <class Role>
+void RF24WaveCore<Role>::assocChanged(MasterPolicy)
+{
+#if defined(WAVE_ADMISSION)
+  _role._assocEpoch++;
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::assocChanged(NodePolicy)
+{
+}
+
+template <class Role>
+void RF24WaveCore<Role>::slotAdded(uint8_t GID, uint8_t slot, MasterPolicy)
+{
+  assocChanged(Role());
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+  _role._heard[GID-1][slot] = (uint16_t)(millis() / 1000);
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::slotAdded(uint8_t GID, uint8_t slot, NodePolicy)
+{
+}
+
+template <class Role>
+void RF24WaveCore<Role>::addListAssociations(info_node_t data)
+{
+  uint8_t i;
+  for(i=0; i<MAX_GROUPS; i++){
+    addAssociation(data.nodeID, data.groupsID[i]);
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::addAssociation(uint8_t NID, uint8_t GID)
+{
+  uint8_t i, temp;
+  uint8_t *row = groupRow(GID);
+  bool added = false;
+  /* Node ignores groups it does not belong to */
+  if(row && NID > 0){
+    i = 0;
+    //We add new association only if we found one zero in listGroupsID
+    while(i < MAX_NODE_GROUPS && !added){
+      temp = row[i];
+      if(temp == 0){
+        row[i] = NID;
+        added = true;
+        slotAdded(GID, i, Role());
+      }else if(temp == NID){
+        added = true;
+      }
+      i++;
+    }
+    if(!added){
+      printLine(PSTR("[addListAssociation] ERR: Unable to add node to group : %d"), GID);
+    }
+  }
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::isPresent(uint8_t NID, uint8_t GID){
+  uint8_t i;
+  uint8_t *row = groupRow(GID);
+  if(NID > 0 && row){
+    for(i=0; i<MAX_NODE_GROUPS; i++){
+      if(row[i] == NID){
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+#if defined(WAVE_LIVENESS)
+template <class Role>
+bool RF24WaveCore<Role>::removeAssociation(uint8_t NID, uint8_t GID)
+{
+  uint8_t i;
+  uint8_t *row = groupRow(GID);
+  if(!row || NID == 0){
+    return false;
+  }
+  for(i=0; i<MAX_NODE_GROUPS && row[i] != NID; i++);
+  if(i == MAX_NODE_GROUPS){
+    return false;
+  }
+  slotRemoved(NID, GID, i, Role());
+  /* Rows stay packed: later nodes move down one slot */
+  for(; i<MAX_NODE_GROUPS-1; i++){
+    row[i] = row[i+1];
+  }
+  row[MAX_NODE_GROUPS-1] = 0;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::slotRemoved(uint8_t NID, uint8_t GID, uint8_t slot, MasterPolicy)
+{
+  for(; slot<MAX_NODE_GROUPS-1; slot++){
+    _role._heard[GID-1][slot] = _role._heard[GID-1][slot+1];
+  }
+  forgetMember(NID, GID);
+  assocChanged(Role());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::slotRemoved(uint8_t NID, uint8_t GID, uint8_t slot, NodePolicy)
+{
+}
+#endif
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::countGroups(uint8_t *groups)
+{
+  uint8_t length=0;
+  /* List ends with a zero, or after MAX_GROUPS groups */
+  while(groups && length < MAX_GROUPS && groups[length]){
+    length++;
+  }
+  return length;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::printAssociation(info_node_t data)
+{
+  uint8_t i;
+  char groups[MY_GATEWAY_MAX_SEND_LENGTH];
+  groups[0] = 0;
+  for(i=0; i<MAX_GROUPS; i++){
+    snprintf_P(groups + strlen(groups), sizeof(groups) - strlen(groups), PSTR("%d; "), data.groupsID[i]);
+  }
+  printLine(PSTR("# Print Associations :"));
+  printLine(PSTR("> NodeID: %d"), data.nodeID);
+  printLine(PSTR("> GroupID: %s"), groups);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::printAssociations()
+{
+  uint8_t i, j;
+  char nodes[MY_GATEWAY_MAX_SEND_LENGTH];
+  printLine(PSTR("# Matrix Associations :"));
+  for(i=0; i<sizeof(_role.listGroupsID)/sizeof(_role.listGroupsID[0]); i++){
+    if(rowGroup(i, Role()) == 0){
+      continue;
+    }
+    nodes[0] = 0;
+    for(j=0; j<MAX_NODE_GROUPS; j++){
+      snprintf_P(nodes + strlen(nodes), sizeof(nodes) - strlen(nodes), PSTR("%d|"), _role.listGroupsID[i][j]);
+    }
+    printLine(PSTR("> GroupID %d : %s"), rowGroup(i, Role()), nodes);
+  }
+  printLine(PSTR(""));
+}
+
+/* Master shares serial with controller: its lines go through the TX queue,
+ * so they are dropped when it is full rather than stalling the radio loop */
+template <class Role>
+void RF24WaveCore<Role>::printLine(const char *format, ...)
+{
+  char line[MY_GATEWAY_MAX_SEND_LENGTH];
+  va_list args;
+  va_start(args, format);
+  vsnprintf_P(line, sizeof(line) - 1, format, args);
+  va_end(args);
+  strcat(line, "\n");
+  writeLine(line, Role());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::writeLine(const char *line, MasterPolicy)
+{
+#if defined(WAVE_TX_QUEUE) && !defined(WAVE_GATEWAY_TCP)
+  gatewayTransportWrite(line);
+#else
+  Serial.print(line);
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::writeLine(const char *line, NodePolicy)
+{
+  Serial.print(line);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::writeLine(const char *line, RepeaterPolicy)
+{
+  Serial.print(line);
+}
+
+template <class Role>
+MyMessage& RF24WaveCore<Role>::build(MyMessage &msg, const uint8_t NID, const uint8_t destID,
+                            const uint8_t childID, const uint8_t command,
+                            const uint8_t type, const bool ack)
+{
+	msg.sender = NID;
+	msg.destination = destID;
+	msg.sensor = childID;
+	msg.type = type;
+	mSetCommand(msg, command);
+	mSetRequestAck(msg, ack);
+	mSetAck(msg, false);
+	return msg;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::protocolH2i(char c)
+{
+	uint8_t i = 0;
+	if (c <= '9') {
+		i += c - '0';
+	} else if (c >= 'a') {
+		i += c - 'a' + 10;
+	} else {
+		i += c - 'A' + 10;
+	}
+	return i;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::protocolParse(MyMessage &message, char *inputString)
+{
+	char *str, *p, *value=NULL;
+	uint8_t bvalue[MAX_PAYLOAD];
+	uint8_t blen = 0;
+	int i = 0;
+	uint8_t command = 0;
+
+	// Extract command data coming on serial line
+	for (str = strtok_r(inputString, ";", &p); // split using semicolon
+	        str && i < 6; // loop while str is not null an max 5 times
+	        str = strtok_r(NULL, ";", &p) // get subsequent tokens
+	    ) {
+		switch (i) {
+		case 0: // Radioid (destination)
+			message.destination = atoi(str);
+			break;
+		case 1: // Childid
+			message.sensor = atoi(str);
+			break;
+		case 2: // Message type
+			command = atoi(str);
+			mSetCommand(message, command);
+			break;
+		case 3: // Should we request ack from destination?
+			mSetRequestAck(message, atoi(str)?1:0);
+			break;
+		case 4: // Data type
+			message.type = atoi(str);
+			break;
+		case 5: // Variable value
+			value = str;
+			if (command != C_STREAM) {
+				// Remove trailing carriage return and newline character (if it exists)
+				uint8_t lastCharacter = strlen(value)-1;
+				if (value[lastCharacter] == '\r') {
+					value[lastCharacter] = 0;
+				}
+				if (value[lastCharacter] == '\n') {
+					value[lastCharacter] = 0;
+				}
+			}
+			break;
+		}
+		i++;
+	}
+	//debug(PSTR("Received %d"), i);
+	// Check for invalid input
+	if (i < 5) {
+		return false;
+	}
+	if (!wanted(message, command, Role())) {
+		return false;
+	}
+	message.sender = GATEWAY_ADDRESS;
+	message.last = GATEWAY_ADDRESS;
+	mSetAck(message, false);
+	if (command == C_STREAM) {
+		str = value;
+		while (str && str[0] && str[1] && blen < MAX_PAYLOAD) {
+			uint8_t val;
+			val = protocolH2i(*str++) << 4;
+			val += protocolH2i(*str++);
+			bvalue[blen] = val;
+			blen++;
+		}
+		message.set(bvalue, blen);
+	} else {
+		message.set(value);
+	}
+	return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::wanted(MyMessage &message, uint8_t command, MasterPolicy)
+{
+	return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::wanted(MyMessage &message, uint8_t command, NodePolicy)
+{
+	// Drop message no handler wants before decoding its value
+#if defined(WAVE_RULES)
+	// Rules are checked on any value, rule loads have no handler
+	return !_role._handlers || command == C_INTERNAL || command == C_STREAM || command == C_SET || findHandler(message);
+#else
+	return !_role._handlers || command == C_INTERNAL || findHandler(message);
+#endif
+}
+
+template <class Role>
+char* RF24WaveCore<Role>::protocolFormat(MyMessage &message)
+{
+	snprintf_P(_scratch.format.buffer, MY_GATEWAY_MAX_SEND_LENGTH, PSTR("%d;%d;%d;%d;%d;%s\n"), message.sender,
+	           message.sensor, (uint8_t)mGetCommand(message), (uint8_t)mGetAck(message), message.type,
+	           message.getString(_scratch.format.conv));
+	return _scratch.format.buffer;
+}
+
+#if defined(WAVE_OTA)
+/***************************** Firmware update ******************************/
+
+template <class Role>
+uint16_t RF24WaveCore<Role>::crc16Update(uint16_t crc, uint8_t data)
+{
+  uint8_t i;
+  crc ^= data;
+  for(i=0; i<8; i++){
+    crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+  }
+  return crc;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::otaStatus()
+{
+  return _ota.status;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendOta(uint8_t command, uint16_t block, uint8_t destID)
+{
+  uint8_t length = FIRMWARE_MSG_HEADER;
+  _otaFrame.command = command;
+  _otaFrame.nodeID = nodeID;
+  _otaFrame.version = _ota.version;
+  _otaFrame.block = block;
+  if(command == ST_FIRMWARE_RESPONSE){
+    length += FIRMWARE_BLOCK_SIZE;
+  }else if(command == ST_FIRMWARE_CONFIG_RESPONSE){
+    memcpy(_otaFrame.data, &_ota.crc, sizeof(_ota.crc));
+    length += sizeof(_ota.crc);
+  }
+  mesh.update();
+  if(!meshWrite(&_otaFrame, OTA_MSG_T, length, destID)){
+    P_DEBUG("[sendOta] ERR: Unable to send firmware message !")
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processOta()
+{
+  processOta(Role());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveOta(firmware_msg_t &msg)
+{
+  receiveOta(msg, Role());
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::otaStart(uint8_t GID, uint16_t version, uint16_t blocks, uint16_t crc, firmware_reader_t reader)
+{
+  uint8_t i;
+  if(GID == 0 || GID > MAX_GROUPS || !reader || _ota.status != OTA_IDLE){
+    return false;
+  }
+  memset(&_ota, 0, sizeof(ota_state_t));
+  _ota.status = OTA_CONFIG;
+  _ota.groupID = GID;
+  _ota.version = version;
+  _ota.blocks = blocks;
+  _ota.crc = crc;
+  _otaReader = reader;
+  memset(_role._otaPull, 0, sizeof(_role._otaPull));
+  /* Members are kept by ID: evictions shift the slots of listGroupsID */
+  for(i=0; i<MAX_NODE_GROUPS; i++){
+    _role._otaPull[i].nodeID = _role.listGroupsID[GID-1][i];
+    _role._otaPull[i].offset = FIRMWARE_WINDOW + 1;
+  }
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::serveOta()
+{
+  ota_pull_t *pull;
+  uint8_t i, slot;
+  uint16_t block;
+  for(i=0; i<MAX_NODE_GROUPS; i++){
+    slot = _role._otaPullIndex;
+    _role._otaPullIndex = (_role._otaPullIndex + 1) % MAX_NODE_GROUPS;
+    pull = &_role._otaPull[slot];
+    /* Skip blocks node already has */
+    while(pull->offset <= FIRMWARE_WINDOW && pull->offset > 0
+          && (pull->window & (1UL << (pull->offset - 1)))){
+      pull->offset++;
+    }
+    block = pull->block + pull->offset;
+    if(pull->nodeID && pull->offset <= FIRMWARE_WINDOW && block < _ota.blocks){
+      _otaReader(block, _otaFrame.data);
+      sendOta(ST_FIRMWARE_RESPONSE, block, pull->nodeID);
+      pull->offset++;
+      return true;
+    }
+    pull->offset = FIRMWARE_WINDOW + 1;
+  }
+  return false;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::endOta()
+{
+  uint8_t i, count = 0, members = 0;
+  for(i=0; i<MAX_NODE_GROUPS; i++){
+    if(_role._otaPull[i].nodeID){
+      members++;
+      if(_ota.staged & (1 << i)){
+        count++;
+      }
+    }
+  }
+  snprintf_P(_scratch.format.conv, sizeof(_scratch.format.conv), PSTR("OTA group %d: %d/%d"), _ota.groupID, count, members);
+  gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set(_scratch.format.conv));
+  _ota.status = OTA_IDLE;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processOta(MasterPolicy)
+{
+  uint8_t NID;
+  if(_ota.status == OTA_IDLE){
+    return;
+  }
+  /* Requested blocks go before pushed ones */
+  if(serveOta()){
+    return;
+  }
+  if(_ota.status == OTA_SERVE){
+    if(millis() - _ota.lastTimer > FIRMWARE_SERVE_TIMEOUT){
+      endOta();
+    }
+    return;
+  }
+  while(_ota.member < MAX_NODE_GROUPS && _role._otaPull[_ota.member].nodeID == 0){
+    _ota.member++;
+  }
+  /* Only one frame per call, each block is read once for the whole group */
+  if(_ota.member < MAX_NODE_GROUPS){
+    NID = _role._otaPull[_ota.member].nodeID;
+    if(_ota.status == OTA_CONFIG){
+      sendOta(ST_FIRMWARE_CONFIG_RESPONSE, _ota.blocks, NID);
+    }else if(!(_ota.staged & (1 << _ota.member))){
+      if(_otaFrame.command != ST_FIRMWARE_RESPONSE || _otaFrame.block != _ota.block){
+        _otaReader(_ota.block, _otaFrame.data);
+      }
+      sendOta(ST_FIRMWARE_RESPONSE, _ota.block, NID);
+    }
+    _ota.member++;
+    return;
+  }
+  _ota.member = 0;
+  if(_ota.status == OTA_CONFIG){
+    _ota.status = OTA_PUSH;
+  }else if(++_ota.block >= _ota.blocks){
+    /* Push done, nodes now request the blocks they missed */
+    _ota.status = OTA_SERVE;
+    _ota.lastTimer = millis();
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveOta(firmware_msg_t &msg, MasterPolicy)
+{
+  uint8_t i, slot = MAX_NODE_GROUPS;
+  if(_ota.status == OTA_IDLE){
+    return;
+  }
+  for(i=0; i<MAX_NODE_GROUPS; i++){
+    if(msg.nodeID && _role._otaPull[i].nodeID == msg.nodeID){
+      slot = i;
+    }
+  }
+  if(slot == MAX_NODE_GROUPS){
+    return;
+  }
+  _ota.lastTimer = millis();
+  if(msg.command == ST_FIRMWARE_REQUEST && msg.version == _ota.version && msg.block < _ota.blocks){
+    /* Served from processOta(), a new request replaces the previous one */
+    _role._otaPull[slot].block = msg.block;
+    memcpy(&_role._otaPull[slot].window, msg.data, sizeof(uint32_t));
+    _role._otaPull[slot].offset = 0;
+  }else if(msg.command == ST_FIRMWARE_CONFIG_REQUEST){
+    if(msg.version == _ota.version){
+      /* Node verified and staged the image */
+      _ota.staged |= 1 << slot;
+      snprintf_P(_scratch.format.conv, sizeof(_scratch.format.conv), PSTR("OTA node %d staged"), msg.nodeID);
+      gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set(_scratch.format.conv));
+    }else{
+      sendOta(ST_FIRMWARE_CONFIG_RESPONSE, _ota.blocks, msg.nodeID);
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::otaBegin(uint16_t version, firmware_writer_t writer, firmware_reader_t reader)
+{
+  memset(&_ota, 0, sizeof(ota_state_t));
+  _role._firmwareVersion = version;
+  _role._otaWriter = writer;
+  _otaReader = reader;
+  /* Gateway answers with current update if any */
+  _ota.version = version;
+  sendOta(ST_FIRMWARE_CONFIG_REQUEST, 0, GATEWAY_ADDRESS);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::storeFirmwareBlock(uint16_t block, const uint8_t *data)
+{
+  uint16_t offset;
+  if(block < _ota.block){
+    return;
+  }
+  offset = block - _ota.block;
+  if(offset == 0){
+    _role._otaWriter(block, data);
+    _ota.block++;
+    while(_ota.window & 1){
+      _ota.window >>= 1;
+      _ota.block++;
+    }
+    _ota.window >>= 1;
+  }else if(offset <= FIRMWARE_WINDOW && !(_ota.window & (1UL << (offset - 1)))){
+    _role._otaWriter(block, data);
+    _ota.window |= 1UL << (offset - 1);
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::requestFirmwareBlocks()
+{
+  uint8_t i;
+  _ota.top = _ota.block;
+  for(i=0; i<FIRMWARE_WINDOW && _ota.block + i + 1 < _ota.blocks; i++){
+    if(!(_ota.window & (1UL << i))){
+      _ota.top = _ota.block + i + 1;
+    }
+  }
+  memcpy(_otaFrame.data, &_ota.window, sizeof(uint32_t));
+  sendOta(ST_FIRMWARE_REQUEST, _ota.block, GATEWAY_ADDRESS);
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::verifyFirmware()
+{
+  uint16_t block, crc = 0xFFFF;
+  uint8_t i;
+  for(block=0; block<_ota.blocks; block++){
+    if(!_otaReader(block, _otaFrame.data)){
+      return false;
+    }
+    for(i=0; i<FIRMWARE_BLOCK_SIZE; i++){
+      crc = crc16Update(crc, _otaFrame.data[i]);
+    }
+  }
+  return crc == _ota.crc;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveOta(firmware_msg_t &msg, NodePolicy)
+{
+  if(!_role._otaWriter){
+    return;
+  }
+  if(msg.command == ST_FIRMWARE_CONFIG_RESPONSE){
+    if(msg.version == _role._firmwareVersion){
+      return;
+    }
+    if(msg.version == _ota.version && _ota.status == OTA_STAGED){
+      /* Gateway missed our report */
+      sendOta(ST_FIRMWARE_CONFIG_REQUEST, _ota.blocks, GATEWAY_ADDRESS);
+      return;
+    }
+    if(msg.version == _ota.version && _ota.status == OTA_RECEIVING){
+      return;
+    }
+    memset(&_ota, 0, sizeof(ota_state_t));
+    _ota.status = OTA_RECEIVING;
+    _ota.version = msg.version;
+    _ota.blocks = msg.block;
+    memcpy(&_ota.crc, msg.data, sizeof(_ota.crc));
+    _ota.lastTimer = millis();
+  }else if(msg.command == ST_FIRMWARE_RESPONSE && _ota.status == OTA_RECEIVING
+            && msg.version == _ota.version && msg.block < _ota.blocks){
+    storeFirmwareBlock(msg.block, msg.data);
+    _ota.lastTimer = millis();
+    _ota.retry = 0;
+    if(_ota.block >= _ota.blocks){
+      /* Staged image is reported to gateway with its version, else the old one */
+      if(verifyFirmware()){
+        _ota.status = OTA_STAGED;
+        sendOta(ST_FIRMWARE_CONFIG_REQUEST, _ota.blocks, GATEWAY_ADDRESS);
+      }else{
+        P_DEBUG("[receiveOta] ERR: Bad firmware CRC !")
+        _ota.status = OTA_FAILED;
+        _ota.version = _role._firmwareVersion;
+        sendOta(ST_FIRMWARE_CONFIG_REQUEST, 0, GATEWAY_ADDRESS);
+      }
+    }else if(_ota.pull && msg.block >= _ota.top){
+      /* Last block of our request, ask next missing ones at once */
+      requestFirmwareBlocks();
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processOta(NodePolicy)
+{
+  if(_ota.status != OTA_RECEIVING || millis() - _ota.lastTimer <= FIRMWARE_TIMEOUT){
+    return;
+  }
+  if(++_ota.retry > FIRMWARE_MAX_RETRY){
+    P_DEBUG("[processOta] ERR: Firmware update aborted !")
+    _ota.status = OTA_FAILED;
+    return;
+  }
+  _ota.lastTimer = millis();
+  _ota.pull = true;
+  requestFirmwareBlocks();
+}
+#endif
+
+template <class Role>
+bool RF24WaveCore<Role>::meshWrite(const void *data, uint8_t type, size_t size, uint8_t NID)
+{
+  bool send = mesh.write(data, type, size, NID);
+#if defined(WAVE_LINK_QUALITY)
+  link_stats_t *link = findLink(NID);
+  if(link->sent == 0xFFFF){
+    return send;
+  }
+  link->sent++;
+  if(send){
+    link->retries += radio.getARC();
+  }else{
+    link->failed++;
+  }
+#endif
+#if defined(WAVE_RATE_ADAPT)
+  writeDone(send, Role());
+#endif
+  return send;
+}
+
+#if defined(WAVE_RATE_ADAPT)
+template <class Role>
+void RF24WaveCore<Role>::writeDone(bool send, MasterPolicy)
+{
+}
+
+template <class Role>
+void RF24WaveCore<Role>::writeDone(bool send, NodePolicy)
+{
+  /* Network may have changed rate while node missed the announce */
+  if(send){
+    _role._writeFailures = 0;
+  }else if(++_role._writeFailures >= RATE_FALLBACK_FAILS){
+    _role._writeFailures = 0;
+    if(!mesh.checkConnection()){
+      renewAddress();
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::writeDone(bool send, RepeaterPolicy)
+{
+}
+#endif
+
+#if defined(WAVE_CHANNEL_SCAN)
+/***************************** Channel functions ****************************/
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::surveyChannels()
+{
+  uint8_t channel, best = WAVE_CHANNEL;
+  uint16_t i, count, bestCount = 0xFFFF;
+  printLine(PSTR("[surveyChannels] Carrier detected per channel :"));
+  for(channel = CHANNEL_SCAN_MIN; channel <= CHANNEL_SCAN_MAX; channel += CHANNEL_SCAN_STEP){
+    radio.setChannel(channel);
+    count = 0;
+    for(i=0; i<CHANNEL_SURVEY_SAMPLES; i++){
+      /* RPD is valid once receiver settled (130us) */
+      radio.startListening();
+      delayMicroseconds(130);
+      radio.stopListening();
+      if(radio.testRPD()){
+        count++;
+      }
+    }
+    printLine(PSTR("> %d : %u"), channel, count);
+    /* Quietest channel wins, first one on a tie */
+    if(count < bestCount){
+      bestCount = count;
+      best = channel;
+    }
+  }
+  printLine(PSTR("[surveyChannels] Selected channel %d"), best);
+  return best;
+}
+#endif
+
+#if defined(WAVE_CHANNEL_SCAN) || defined(WAVE_RATE_ADAPT)
+template <class Role>
+bool RF24WaveCore<Role>::scanMesh()
+{
+  uint8_t channel, i;
+#if defined(WAVE_CHANNEL_SCAN)
+  uint8_t first = CHANNEL_SCAN_MIN, last = CHANNEL_SCAN_MAX;
+#else
+  uint8_t first = radio.getChannel(), last = first;
+#endif
+  /* Only a channel and rate where master runs answer address request */
+  for(channel = first; channel <= last; channel += CHANNEL_SCAN_STEP){
+    mesh.setChannel(channel);
+    for(i=0; i<WAVE_SCAN_RATES; i++){
+#if defined(WAVE_RATE_ADAPT)
+      radio.setDataRate(dataRates[i]);
+#endif
+      if(mesh.renewAddress(CHANNEL_SCAN_TIMEOUT) != MESH_DEFAULT_ADDRESS){
+        Serial.print(F("[scanMesh] Joined on channel "));
+        Serial.print(channel);
+        Serial.print(F(" rate "));
+        Serial.println(radio.getDataRate());
+#if defined(WAVE_RATE_ADAPT)
+        _rateLevel = i;
+#endif
+        return true;
+      }
+    }
+  }
+  P_DEBUG("[scanMesh] No master found")
+  return false;
+}
+#endif
+
+#if defined(WAVE_RATE_ADAPT)
+/***************************** Rate functions *******************************/
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::dataRateLevel()
+{
+  uint8_t i;
+  for(i=0; i<WAVE_SCAN_RATES; i++){
+    if(dataRates[i] == radio.getDataRate()){
+      return i;
+    }
+  }
+  return 0;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::adaptRate()
+{
+  uint8_t i, level, target;
+  uint8_t strength = 100;
+  bool counted = false, lossy = false;
+  link_stats_t *link;
+  uint32_t currentTimer = millis();
+  if(currentTimer - _role._rateTimer < RATE_ADAPT_DELAY){
+    return;
+  }
+  _role._rateTimer = currentTimer;
+  /* Rate must suit the weakest link */
+  for(i=0; i<LINK_MAX_NODES; i++){
+    link = &_links[i];
+    if(link->nodeID == 0xFF || link->quality == 255){
+      continue;
+    }
+    counted = true;
+    if(link->quality < RATE_QUALITY_MIN){
+      lossy = true;
+    }
+    if(link->strength < strength){
+      strength = link->strength;
+    }
+  }
+  if(!counted){
+    return;
+  }
+  if(strength != 255 && strength >= RATE_2MBPS_STRENGTH){
+    target = 2;
+  }else if(strength != 255 && strength >= RATE_1MBPS_STRENGTH){
+    target = 1;
+  }else{
+    target = 0;
+  }
+  /* A rate which lost frames stays out of reach for a while */
+  if(_role._rateHold > 0 && --_role._rateHold == 0){
+    _role._rateCeiling = WAVE_SCAN_RATES - 1;
+  }
+  if(target > _role._rateCeiling){
+    target = _role._rateCeiling;
+  }
+  /* One step at a time, down as soon as a link loses frames */
+  level = _rateLevel;
+  if(lossy && level > 0){
+    level--;
+    _role._rateCeiling = level;
+    _role._rateHold = RATE_HOLD_PERIODS;
+  }else if(!lossy && target < level){
+    level--;
+  }else if(!lossy && target > level){
+    level++;
+  }
+  if(level != _rateLevel){
+    sendRate(level);
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendRate(uint8_t level)
+{
+  uint8_t i, depth, nodeDepth;
+  uint8_t rate = dataRates[level];
+  uint16_t address;
+  printLine(PSTR("[sendRate] Network rate level %d"), level);
+  /* Deepest nodes first, so relays switch after their children */
+  for(depth=5; depth>0; depth--){
+    for(i=0; i<mesh.addrListTop; i++){
+      address = mesh.addrList[i].address;
+      for(nodeDepth=0; address; nodeDepth++){
+        address >>= 3;
+      }
+      if(nodeDepth == depth){
+        meshWrite(&rate, RATE_MSG_T, sizeof(rate), mesh.addrList[i].nodeID);
+      }
+    }
+  }
+  radio.setDataRate((rf24_datarate_e)rate);
+  _rateLevel = level;
+  /* Metrics measured at previous rate are obsolete */
+  for(i=0; i<LINK_MAX_NODES; i++){
+    _links[i].quality = 255;
+    _links[i].strength = 255;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveRate(uint8_t rate)
+{
+  radio.setDataRate((rf24_datarate_e)rate);
+  _rateLevel = dataRateLevel();
+  printLine(PSTR("[receiveRate] Network rate level %d"), _rateLevel);
+}
+#endif
+
+#if defined(WAVE_TIME_SYNC)
+/***************************** Time functions *******************************/
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::networkTime()
+{
+  return networkTime(Role());
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::networkEpoch()
+{
+  return networkEpoch(Role());
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::networkTime(MasterPolicy)
+{
+  /* Master clock is the network clock */
+  return millis();
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::networkEpoch(MasterPolicy)
+{
+  if(!_role._epoch){
+    return 0;
+  }
+  return _role._epoch + (millis() - _role._epochLocal) / 1000;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveEpoch(uint32_t seconds)
+{
+  _role._epoch = seconds;
+  _role._epochLocal = millis();
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::fireTime(const MyMessage &message)
+{
+  uint32_t seconds, time;
+  int64_t ahead;
+  if(mGetLength(message) != sizeof(seconds)){
+    return 0;
+  }
+  if(!_role._epoch){
+    gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set("No controller time, fired on receipt"));
+    return 0;
+  }
+  memcpy(&seconds, message.data, sizeof(seconds));
+  /* Nodes compare network times as signed 32 bit differences */
+  ahead = (int64_t)(int32_t)(seconds - _role._epoch) * 1000 - (millis() - _role._epochLocal);
+  if(ahead > 0x7FFFFFFFL){
+    gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set("Fire time too far, fired on receipt"));
+    return 0;
+  }
+  /* 0 stands for no fire time, a time in the past is actuated on receipt */
+  time = ahead > 0 ? millis() + (uint32_t)ahead : millis();
+  return time ? time : 1;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendTime(uint8_t NID)
+{
+  time_msg_t msg;
+  /* Stamped just before write, so only air time is left uncorrected */
+  msg.time = networkTime();
+  msg.epoch = _role._epoch;
+  msg.epochTime = _role._epochLocal;
+  meshWrite(&msg, TIME_MSG_T, sizeof(time_msg_t), NID);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processTime()
+{
+  uint32_t currentTimer = millis();
+  /* One node per call, round starts again every TIME_SYNC_DELAY */
+  if(_role._timeIndex >= mesh.addrListTop){
+    if(currentTimer - _role._timeTimer < TIME_SYNC_DELAY){
+      return;
+    }
+    _role._timeTimer = currentTimer;
+    _role._timeIndex = 0;
+    return;
+  }
+  sendTime(mesh.addrList[_role._timeIndex].nodeID);
+  _role._timeIndex++;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::sendFire(group_cmd_t *cmd, uint8_t NID)
+{
+  timed_msg_t fire;
+  fire.time = cmd->fireAt;
+  fire.message = cmd->message;
+  return meshWrite(&fire, FIRE_MSG_T, sizeof(uint32_t) + HEADER_SIZE + mGetLength(cmd->message), NID);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::forwardStamped(timed_msg_t &stamped)
+{
+  char *line = protocolFormat(stamped.message);
+  size_t length = strlen(line);
+  /* Reading time goes to controller as an extra field before newline */
+  if(length > 0 && line[length-1] == '\n'){
+    length--;
+  }
+  snprintf_P(line + length, MY_GATEWAY_MAX_SEND_LENGTH - length, PSTR(";%lu\n"), (unsigned long)stamped.time);
+  gatewayTransportWrite(line);
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::networkTime(NodePolicy)
+{
+  uint32_t elapsed;
+  if(!_role._timeSynced){
+    return millis();
+  }
+  elapsed = millis() - _role._timeLocal;
+  /* Local clock corrected by drift measured between two syncs */
+  return _role._timeNetwork + elapsed + (int32_t)(elapsed / 1000) * _role._timeDrift / 1000;
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::networkEpoch(NodePolicy)
+{
+  if(!_role._timeEpoch){
+    return 0;
+  }
+  return _role._timeEpoch + (networkTime() - _role._timeEpochTime) / 1000;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::timeSynced()
+{
+  return _role._timeSynced;
+}
+
+template <class Role>
+int32_t RF24WaveCore<Role>::timeDrift()
+{
+  return _role._timeDrift;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveTime(const time_msg_t &msg)
+{
+  uint32_t local = millis();
+  int32_t elapsedLocal, elapsedNetwork, sample;
+  elapsedLocal = local - _role._timeLocal;
+  /* Too close to previous sync to measure drift: only move the offset */
+  if(_role._timeSynced && elapsedLocal >= TIME_SYNC_DELAY / 2 && elapsedLocal >= 1000){
+    elapsedNetwork = msg.time - _role._timeNetwork;
+    /* Clock far off: master changed (standby takeover), drift starts again */
+    if(elapsedNetwork - elapsedLocal > elapsedLocal / 100 || elapsedLocal - elapsedNetwork > elapsedLocal / 100){
+      _role._timeSamples = 0;
+      _role._timeDrift = 0;
+    }else{
+      sample = (elapsedNetwork - elapsedLocal) * 1000 / (elapsedLocal / 1000);
+      if(sample > TIME_MAX_DRIFT){
+        sample = TIME_MAX_DRIFT;
+      }else if(sample < -TIME_MAX_DRIFT){
+        sample = -TIME_MAX_DRIFT;
+      }
+      _role._timeDrift = _role._timeSamples ? (_role._timeDrift * 3 + sample) / 4 : sample;
+      if(_role._timeSamples < 0xFF){
+        _role._timeSamples++;
+      }
+    }
+  }
+  _role._timeSynced = true;
+  _role._timeLocal = local;
+  _role._timeNetwork = msg.time;
+  _role._timeEpoch = msg.epoch;
+  _role._timeEpochTime = msg.epochTime;
+  P_DEBUG("[receiveTime] Network time updated")
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::sendStamped(MyMessage &message)
+{
+  timed_msg_t stamped;
+  uint8_t retry;
+  message.sender = nodeID;
+  stamped.time = networkTime();
+  stamped.message = message;
+  for(retry=0; retry<NB_RETRY_SEND; retry++){
+    mesh.update();
+    if(meshWrite(&stamped, STAMPED_MSG_T, sizeof(uint32_t) + HEADER_SIZE + mGetLength(message), GATEWAY_ADDRESS)){
+      return true;
+    }
+  }
+  Serial.println(F("[sendStamped] Unable to send reading"));
+  return false;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::queueFire(const timed_msg_t &fire)
+{
+  /* No network time yet, late or no room left: actuate now rather than never */
+  if(!_role._timeSynced || (int32_t)(networkTime() - fire.time) >= 0 || _role._fireCount >= TIME_FIRE_QUEUE){
+    dispatch(fire.message);
+    return;
+  }
+  _role._fireQueue[_role._fireCount++] = fire;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processFires()
+{
+  uint8_t i = 0;
+  uint32_t now = networkTime();
+  while(i < _role._fireCount){
+    if((int32_t)(now - _role._fireQueue[i].time) >= 0){
+      dispatch(_role._fireQueue[i].message);
+      _role._fireQueue[i] = _role._fireQueue[--_role._fireCount];
+    }else{
+      i++;
+    }
+  }
+}
+#endif
+
+#if defined(WAVE_SIGNING)
+/***************************** Signing functions ****************************/
+
+static_assert(SIGN_POOL_SIZE <= 8, "Used nonces are kept in one byte");
+static_assert(SIGN_MIN_SIZE <= SIGN_MAX_SIZE && SIGN_MAX_SIZE <= 8, "Signature is a truncated 64 bits MAC");
+
+#define SIP_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+inline void sipRound(uint64_t *v)
+{
+  v[0] += v[1]; v[1] = SIP_ROTL(v[1], 13); v[1] ^= v[0]; v[0] = SIP_ROTL(v[0], 32);
+  v[2] += v[3]; v[3] = SIP_ROTL(v[3], 16); v[3] ^= v[2];
+  v[0] += v[3]; v[3] = SIP_ROTL(v[3], 21); v[3] ^= v[0];
+  v[2] += v[1]; v[1] = SIP_ROTL(v[1], 17); v[1] ^= v[2]; v[2] = SIP_ROTL(v[2], 32);
+}
+
+inline void sipCompress(uint64_t *v, uint64_t m)
+{
+  v[3] ^= m;
+  sipRound(v);
+  sipRound(v);
+  v[0] ^= m;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::setSigningKey(const uint8_t *key)
+{
+  uint8_t i;
+  _role._signKey[0] = 0;
+  _role._signKey[1] = 0;
+  for(i=0; i<8; i++){
+    _role._signKey[0] |= (uint64_t)key[i] << (8 * i);
+    _role._signKey[1] |= (uint64_t)key[i + 8] << (8 * i);
+  }
+  _role._signKeyed = true;
+}
+
+template <class Role>
+const sign_stats_t& RF24WaveCore<Role>::signStats()
+{
+  return _role._signStats;
+}
+
+template <class Role>
+uint64_t RF24WaveCore<Role>::signMac(const uint64_t *key, uint64_t prefix, const uint8_t *data, uint8_t length)
+{
+  /* SipHash-2-4 of the 8 bytes of prefix followed by data */
+  uint64_t v[4], m;
+  uint8_t i, j;
+  v[0] = key[0] ^ 0x736f6d6570736575ULL;
+  v[1] = key[1] ^ 0x646f72616e646f6dULL;
+  v[2] = key[0] ^ 0x6c7967656e657261ULL;
+  v[3] = key[1] ^ 0x7465646279746573ULL;
+  sipCompress(v, prefix);
+  for(i=0; i + 8 <= length; i += 8){
+    m = 0;
+    for(j=0; j<8; j++){
+      m |= (uint64_t)data[i + j] << (8 * j);
+    }
+    sipCompress(v, m);
+  }
+  m = (uint64_t)(uint8_t)(length + 8) << 56;
+  for(j=0; i + j < length; j++){
+    m |= (uint64_t)data[i + j] << (8 * j);
+  }
+  sipCompress(v, m);
+  v[2] ^= 0xff;
+  for(j=0; j<4; j++){
+    sipRound(v);
+  }
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::signSize(uint8_t length)
+{
+  /* Longest signature that still fits the notification in one radio frame */
+  int8_t room = SIGN_RADIO_PAYLOAD - HEADER_SIZE - 1 - (int8_t)length;
+  if(room < SIGN_MIN_SIZE){
+    return SIGN_MIN_SIZE;
+  }
+  return room > SIGN_MAX_SIZE ? SIGN_MAX_SIZE : room;
+}
+
+template <class Role>
+sign_peer_t* RF24WaveCore<Role>::findSignPeer(uint8_t NID, bool create)
+{
+  uint8_t i;
+  sign_peer_t *peer = NULL;
+  for(i=0; i<SIGN_MAX_PEERS; i++){
+    if(_role._signPeers[i].nodeID == NID){
+      return &_role._signPeers[i];
+    }
+    if(!peer && _role._signPeers[i].nodeID == 0){
+      peer = &_role._signPeers[i];
+    }
+  }
+  if(!create || NID == 0){
+    return NULL;
+  }
+  if(!peer){
+    /* More peers than slots: pools of the oldest one are lost */
+    peer = &_role._signPeers[_role._signEvict];
+    _role._signEvict = (_role._signEvict + 1) % SIGN_MAX_PEERS;
+  }
+  memset(peer, 0, sizeof(sign_peer_t));
+  peer->nodeID = NID;
+  return peer;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::requestNonces(uint8_t NID)
+{
+  if(!_role._signKeyed || millis() - _role._signTimer < SIGN_REQUEST_DELAY){
+    return false;
+  }
+  _role._signTimer = millis();
+  _role._signStats.requests++;
+  meshWrite(&nodeID, NONCE_REQUEST_MSG_T, sizeof(nodeID), NID);
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::issueNonces(uint8_t NID)
+{
+  nonce_msg_t msg;
+  sign_peer_t *peer;
+  /* Nonces of an unset key could be computed by anyone */
+  if(!_role._signKeyed){
+    return;
+  }
+  peer = findSignPeer(NID, true);
+  if(!peer){
+    return;
+  }
+  /* Keyed hash of the clock, a counter and a random draw, unknown to peers */
+  msg.nonce = (uint32_t)signMac(_role._signKey, ((uint64_t)millis() << 32) | ((uint32_t)random(0x8000) << 16)
+    | ++_role._signCounter, &nodeID, sizeof(nodeID));
+  msg.nodeID = nodeID;
+  msg.count = SIGN_POOL_SIZE;
+  /* Previous pool is dropped, peer only asks once it used it */
+  peer->rxNonce = msg.nonce;
+  peer->rxUsed = 0;
+  peer->rxCount = msg.count;
+  meshWrite(&msg, NONCE_MSG_T, sizeof(nonce_msg_t), NID);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveNonces(const nonce_msg_t &msg)
+{
+  sign_peer_t *peer = findSignPeer(msg.nodeID, true);
+  if(!peer){
+    return;
+  }
+  peer->txNonce = msg.nonce;
+  peer->txNext = 0;
+  peer->txCount = msg.count > SIGN_POOL_SIZE ? SIGN_POOL_SIZE : msg.count;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::signFrame(MyMessage &message, uint8_t NID, uint8_t *frame)
+{
+  uint8_t i, size, tag, index;
+  uint64_t mac;
+  sign_peer_t *peer = findSignPeer(NID, false);
+  if(!_role._signKeyed || !peer || peer->txNext >= peer->txCount){
+    return 0;
+  }
+  index = peer->txNext++;
+  mSetSigned(message, 1);
+  size = HEADER_SIZE + mGetLength(message);
+  memcpy(frame, &message, size);
+  frame[size] = index;
+  /* Nonce, index and both ends are hashed, frame only carries the index */
+  mac = signMac(_role._signKey, peer->txNonce | (uint64_t)index << 32 | (uint64_t)NID << 40
+    | (uint64_t)nodeID << 48 | (uint64_t)NOTIF_MSG_T << 56, frame, size);
+  tag = signSize(mGetLength(message));
+  for(i=0; i<tag; i++){
+    frame[size + 1 + i] = (uint8_t)(mac >> (8 * i));
+  }
+  _role._signStats.signedFrames++;
+  return size + 1 + tag;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::verifyFrame(const uint8_t *frame, uint8_t size, MyMessage &message)
+{
+  uint8_t i, length, tag, index, diff;
+  uint64_t mac;
+  sign_peer_t *peer;
+  /* Frame buffer is as large as a message, header is read in place */
+  const MyMessage *received = reinterpret_cast<const MyMessage *>(frame);
+  if(!_role._signKeyed || size < HEADER_SIZE){
+    _role._signStats.rejected++;
+    return false;
+  }
+  length = mGetLength((*received));
+  tag = signSize(length);
+  if(!mGetSigned((*received)) || length > MAX_PAYLOAD || size < HEADER_SIZE + length + 1 + tag){
+    _role._signStats.rejected++;
+    return false;
+  }
+  index = frame[HEADER_SIZE + length];
+  peer = findSignPeer(received->sender, false);
+  if(!peer || index >= peer->rxCount || (peer->rxUsed & (1 << index))){
+    /* No pool handed to sender, or nonce already used */
+    _role._signStats.rejected++;
+    return false;
+  }
+  mac = signMac(_role._signKey, peer->rxNonce | (uint64_t)index << 32 | (uint64_t)nodeID << 40
+    | (uint64_t)received->sender << 48 | (uint64_t)NOTIF_MSG_T << 56, frame, HEADER_SIZE + length);
+  /* Every byte compared, time does not tell how many matched */
+  diff = 0;
+  for(i=0; i<tag; i++){
+    diff |= frame[HEADER_SIZE + length + 1 + i] ^ (uint8_t)(mac >> (8 * i));
+  }
+  if(diff){
+    _role._signStats.rejected++;
+    return false;
+  }
+  peer->rxUsed |= 1 << index;
+  memcpy(&message, frame, HEADER_SIZE + length);
+  _role._signStats.verified++;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processSigning()
+{
+  broadcast_list_t *elt;
+  sign_peer_t *peer;
+  /* Pools are fetched ahead, a notification does not wait a round trip */
+  for(elt = _role.headBroadcastList; elt; elt = elt->next){
+    peer = findSignPeer(elt->nodeID, false);
+    if(!peer || peer->txNext >= peer->txCount){
+      requestNonces(elt->nodeID);
+      return;
+    }
+  }
+}
+#endif
+
+#if defined(WAVE_RULES)
+/***************************** Rule functions *******************************/
+
+template <class Role>
+void RF24WaveCore<Role>::sendRule(uint8_t NID, uint8_t index, const rule_t &rule)
+{
+  rule_t payload = rule;
+  /* Same frame as a rule loaded by controller through serial */
+  build(_msgTmp, nodeID, NID, index, C_STREAM, RULE_STREAM_TYPE, false).set(&payload, sizeof(rule_t));
+  transmitMyMessage(_msgTmp, NID);
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::setRule(uint8_t index, const rule_t &rule)
+{
+  if(index >= RULES_MAX){
+    return false;
+  }
+  _role._rules[index] = rule;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::clearRules()
+{
+  memset(_role._rules, 0, sizeof(_role._rules));
+}
+
+template <class Role>
+const rule_t* RF24WaveCore<Role>::rule(uint8_t index)
+{
+  if(index >= RULES_MAX || _role._rules[index].op == RULE_NONE){
+    return NULL;
+  }
+  return &_role._rules[index];
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveRule(const MyMessage &message)
+{
+  rule_t rule;
+  /* childID is the slot, an empty payload clears it (255: all of them) */
+  if(mGetLength(message) == 0){
+    if(message.sensor == 255){
+      clearRules();
+    }else if(message.sensor < RULES_MAX){
+      _role._rules[message.sensor].op = RULE_NONE;
+    }
+    P_DEBUG("[receiveRule] Rule cleared")
+    return;
+  }
+  if(mGetLength(message) != sizeof(rule_t)){
+    P_DEBUG("[receiveRule] ERR: Bad rule size")
+    return;
+  }
+  memcpy(&rule, message.data, sizeof(rule_t));
+  if(setRule(message.sensor, rule)){
+    P_DEBUG("[receiveRule] Rule loaded")
+  }
+}
+
+template <class Role>
+int32_t RF24WaveCore<Role>::ruleValue(const MyMessage &message)
+{
+  switch(mGetPayloadType(message)){
+    case P_BYTE:
+      return message.getByte();
+    case P_INT16:
+      return message.getInt();
+    case P_UINT16:
+      return message.getUInt();
+    case P_ULONG32:
+      return (int32_t)message.getULong();
+    case P_FLOAT32:
+      /* Floats are compared on their integer part */
+      return (int32_t)message.getFloat();
+    default:
+      return message.getLong();
+  }
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::matchRule(const rule_t &rule, const MyMessage &message, int32_t value)
+{
+  if(rule.sender != WAVE_ANY && rule.sender != message.sender){
+    if(!IS_GROUP_ADDRESS(rule.sender) || !isPresent(message.sender, rule.sender - GROUP_ADDRESS_BASE)){
+      return false;
+    }
+  }
+  if((rule.sensor != WAVE_ANY && rule.sensor != message.sensor)
+      || (rule.type != WAVE_ANY && rule.type != message.type)){
+    return false;
+  }
+  switch(rule.op){
+    case RULE_ANY:
+      return true;
+    case RULE_EQ:
+      return value == rule.threshold;
+    case RULE_NE:
+      return value != rule.threshold;
+    case RULE_GT:
+      return value > rule.threshold;
+    case RULE_LT:
+      return value < rule.threshold;
+    default:
+      return false;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::setRuleValue(MyMessage &message, const rule_t &rule, const MyMessage &trigger)
+{
+  if(rule.flags & RULE_COPY_VALUE){
+    memcpy(message.data, trigger.data, sizeof(message.data));
+    mSetLength(message, mGetLength(trigger));
+    mSetPayloadType(message, mGetPayloadType(trigger));
+  }else if(rule.argument >= 0 && rule.argument <= 0xFF){
+    /* Small values as a byte, so handlers reading getBool() work */
+    message.set((uint8_t)rule.argument);
+  }else{
+    message.set(rule.argument);
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::applyRules(const MyMessage &message)
+{
+  uint8_t i;
+  int32_t value;
+  MyMessage action;
+  MyMessage *notif;
+  if(mGetCommand(message) != C_SET){
+    return;
+  }
+  value = ruleValue(message);
+  for(i=0; i<RULES_MAX; i++){
+    if(_role._rules[i].op == RULE_NONE || !matchRule(_role._rules[i], message, value)){
+      continue;
+    }
+    if(_role._rules[i].action == RULE_NOTIFY){
+      /* Sent by listen() like any notification of this node */
+      notif = queueNotification(_role._rules[i].childID, _role._rules[i].childType);
+      if(notif){
+        setRuleValue(*notif, _role._rules[i], message);
+      }
+    }else{
+      /* Local actuator is driven without a controller round trip */
+      action.clear();
+      build(action, nodeID, nodeID, _role._rules[i].childID, C_SET, _role._rules[i].childType, false);
+      setRuleValue(action, _role._rules[i], message);
+      dispatch(action);
+    }
+  }
+}
+#endif
+
+#if defined(WAVE_LINK_QUALITY)
+/***************************** Link functions *******************************/
+
+template <class Role>
+const link_stats_t* RF24WaveCore<Role>::linkStats(uint8_t NID)
+{
+  uint8_t i;
+  for(i=0; i<LINK_MAX_NODES; i++){
+    if(_links[i].nodeID == NID){
+      return &_links[i];
+    }
+  }
+  return NULL;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::linkPALevel()
+{
+  return _linkPA;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::linkRetries()
+{
+  return _linkRetries;
+}
+
+template <class Role>
+link_stats_t* RF24WaveCore<Role>::findLink(uint8_t NID)
+{
+  uint8_t i, slot = 0;
+  link_stats_t *link = (link_stats_t*) linkStats(NID);
+  if(link){
+    return link;
+  }
+  /* Replace least used link */
+  for(i=1; i<LINK_MAX_NODES; i++){
+    if(_links[i].sent + _links[i].received < _links[slot].sent + _links[slot].received){
+      slot = i;
+    }
+  }
+  memset(&_links[slot], 0, sizeof(link_stats_t));
+  _links[slot].nodeID = NID;
+  _links[slot].quality = 255;
+  _links[slot].strength = 255;
+  return &_links[slot];
+}
+
+template <class Role>
+void RF24WaveCore<Role>::recordReceive(RF24NetworkHeader &header)
+{
+  link_stats_t *link;
+  int16_t NID = GATEWAY_ADDRESS;
+  /* Frames reach a node through its uplink, credited to the gateway */
+  if(Role::master){
+    NID = mesh.getNodeID(header.from_node);
+    if(NID < 0){
+      return;
+    }
+  }
+  link = findLink(NID);
+  if(link->received == 0xFFFF){
+    return;
+  }
+  link->received++;
+  if(_linkStrong){
+    link->strong++;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::linkReset()
+{
+  uint8_t i;
+  for(i=0; i<LINK_MAX_NODES; i++){
+    memset(&_links[i], 0, sizeof(link_stats_t));
+    _links[i].nodeID = 0xFF;
+    _links[i].quality = 255;
+    _links[i].strength = 255;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::linkBegin()
+{
+  linkReset();
+  _linkPA = radio.getPALevel();
+  if(_linkPA < LINK_PA_MIN){
+    _linkPA = LINK_PA_MIN;
+  }else if(_linkPA > LINK_PA_MAX){
+    _linkPA = LINK_PA_MAX;
+  }
+  _linkRetries = LINK_RETRY_MAX;
+  _linkDelay = 0;
+  _linkTimer = millis();
+  applyLink();
+}
+
+template <class Role>
+void RF24WaveCore<Role>::applyLink()
+{
+  /* Same stagger as RF24Network::begin(), so neighbours do not collide */
+  uint8_t retryDelay = (((network.node_address % 6) + 1) * 2) + 3 + _linkDelay;
+  radio.setPALevel(_linkPA);
+  if(retryDelay > 15){
+    retryDelay = 15;
+  }
+  radio.setRetries(retryDelay, _linkRetries);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::adaptLink()
+{
+  uint8_t i;
+  bool counted = false, raise = false, lower = true;
+  link_stats_t *link;
+  uint32_t currentTimer = millis();
+  if(currentTimer - _linkTimer < LINK_ADAPT_DELAY){
+    return;
+  }
+  _linkTimer = currentTimer;
+  /* Power must suit the worst link: one bad link raises, all good lower */
+  for(i=0; i<LINK_MAX_NODES; i++){
+    link = &_links[i];
+    if(link->nodeID == 0xFF || link->sent < LINK_MIN_SAMPLES){
+      continue;
+    }
+    counted = true;
+    if((uint32_t)link->failed * 100 > (uint32_t)LINK_LOSS_HIGH * link->sent
+        || (uint32_t)link->retries * 10 > (uint32_t)LINK_ARC_HIGH * link->sent){
+      raise = true;
+    }
+    if(link->failed > 0
+        || (uint32_t)link->retries * 10 >= (uint32_t)LINK_ARC_LOW * link->sent
+        || (uint32_t)link->strong * 100 < (uint32_t)LINK_STRONG_MIN * link->received){
+      lower = false;
+    }
+    link->quality = (uint32_t)(link->sent - link->failed) * 100 / link->sent;
+    if(link->received > 0){
+      link->strength = (uint32_t)link->strong * 100 / link->received;
+    }
+    link->sent = link->failed = link->retries = 0;
+    link->received = link->strong = 0;
+  }
+  if(!counted){
+    return;
+  }
+  /* Power first when raising, retries first when lowering */
+  if(raise){
+    if(_linkPA < LINK_PA_MAX){
+      _linkPA++;
+    }else if(_linkRetries < LINK_RETRY_MAX){
+      _linkRetries = (_linkRetries + 2 > LINK_RETRY_MAX) ? LINK_RETRY_MAX : _linkRetries + 2;
+      _linkDelay++;
+    }
+  }else if(lower){
+    if(_linkRetries > LINK_RETRY_MIN){
+      _linkRetries = (_linkRetries < LINK_RETRY_MIN + 2) ? LINK_RETRY_MIN : _linkRetries - 2;
+      if(_linkDelay > 0){
+        _linkDelay--;
+      }
+    }else if(_linkPA > LINK_PA_MIN){
+      _linkPA--;
+    }
+  }
+  applyLink();
+#if defined(WAVE_DEBUG)
+  printLine(PSTR("[adaptLink] PA: %d retries: %d"), _linkPA, _linkRetries);
+#endif
+}
+#endif
+
+#if defined(WAVE_STREAM)
+/***************************** Stream functions *****************************/
+
+template <class Role>
+bool RF24WaveCore<Role>::streamSend(uint8_t destID, const void *data, uint16_t length)
+{
+  if(_streamTx.status == STREAM_BUSY){
+    return false;
+  }
+  memset(&_streamTx, 0, sizeof(stream_state_t));
+  memset(&_streamStats, 0, sizeof(stream_stats_t));
+  _streamData = (const uint8_t *)data;
+  _streamTx.status = STREAM_BUSY;
+  _streamTx.nodeID = destID;
+  _streamTx.streamID = ++_streamID;
+  _streamTx.length = length;
+  _streamTx.lastTimer = millis();
+  _streamStats.duration = _streamTx.lastTimer;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::streamReceive(void *buffer, uint16_t size)
+{
+  _streamBuffer = (uint8_t *)buffer;
+  _streamBufferSize = size;
+  _streamSink = NULL;
+  _streamRx.status = STREAM_IDLE;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::streamReceive(stream_sink_t sink)
+{
+  _streamBuffer = NULL;
+  _streamBufferSize = 0;
+  _streamSink = sink;
+  _streamRx.status = STREAM_IDLE;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::streamSendStatus()
+{
+  return _streamTx.status;
+}
+
+template <class Role>
+uint8_t RF24WaveCore<Role>::streamReceiveStatus()
+{
+  return _streamRx.status;
+}
+
+template <class Role>
+uint16_t RF24WaveCore<Role>::streamReceivedLength()
+{
+  return _streamRx.length;
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::streamThroughput()
+{
+  if(_streamTx.status != STREAM_DONE || _streamStats.duration == 0){
+    return 0;
+  }
+  return _streamStats.bytes * 1000UL / _streamStats.duration;
+}
+
+template <class Role>
+const stream_stats_t& RF24WaveCore<Role>::streamStats()
+{
+  return _streamStats;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processStream()
+{
+  stream_chunk_t chunk;
+  uint16_t chunks, offset;
+  uint8_t length;
+  uint32_t currentTimer = millis();
+  if(_streamTx.status != STREAM_BUSY){
+    return;
+  }
+  chunks = (_streamTx.length + STREAM_CHUNK_SIZE - 1) / STREAM_CHUNK_SIZE;
+  /* Without progress, missing chunks of window are sent again */
+  if(currentTimer - _streamTx.lastTimer > STREAM_TIMEOUT){
+    if(++_streamTx.retry > STREAM_MAX_RETRY){
+      P_DEBUG("[processStream] ERR: Stream aborted !")
+      _streamTx.status = STREAM_FAILED;
+      return;
+    }
+    _streamTx.next = _streamTx.base;
+    _streamTx.lastTimer = currentTimer;
+    _streamStats.retransmissions++;
+  }
+  while(_streamTx.next > _streamTx.base && _streamTx.next < chunks
+        && (_streamTx.bitmap & (1U << (_streamTx.next - _streamTx.base - 1)))){
+    _streamTx.next++;
+  }
+  /* Only one frame per call so listen() keeps servicing radio */
+  if(_streamTx.next < chunks && _streamTx.next < _streamTx.base + STREAM_WINDOW){
+    offset = _streamTx.next * STREAM_CHUNK_SIZE;
+    length = min((uint16_t)(_streamTx.length - offset), (uint16_t)STREAM_CHUNK_SIZE);
+    chunk.nodeID = nodeID;
+    chunk.streamID = _streamTx.streamID;
+    chunk.seq = _streamTx.next;
+    chunk.length = _streamTx.length;
+    memcpy(chunk.data, _streamData + offset, length);
+    if(meshWrite(&chunk, STREAM_MSG_T, STREAM_CHUNK_HEADER + length, _streamTx.nodeID)){
+      _streamTx.next++;
+      _streamStats.frames++;
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveStreamAck(stream_ack_t &ack)
+{
+  uint16_t chunks;
+  if(_streamTx.status != STREAM_BUSY || ack.streamID != _streamTx.streamID
+      || ack.base < _streamTx.base){
+    return;
+  }
+  if(ack.base > _streamTx.base || (ack.bitmap & ~_streamTx.bitmap)){
+    _streamTx.retry = 0;
+    _streamTx.lastTimer = millis();
+  }
+  _streamTx.base = ack.base;
+  _streamTx.bitmap = ack.bitmap;
+  if(_streamTx.next < _streamTx.base){
+    _streamTx.next = _streamTx.base;
+  }
+  chunks = (_streamTx.length + STREAM_CHUNK_SIZE - 1) / STREAM_CHUNK_SIZE;
+  if(_streamTx.base >= chunks){
+    _streamTx.status = STREAM_DONE;
+    _streamStats.bytes = _streamTx.length;
+    _streamStats.duration = millis() - _streamStats.duration;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveStreamChunk(stream_chunk_t &chunk, uint8_t size)
+{
+  uint16_t chunks, offset;
+  uint8_t length;
+  bool ackNow = false;
+  if(size < STREAM_CHUNK_HEADER){
+    return;
+  }
+  length = size - STREAM_CHUNK_HEADER;
+  /* A new stream replaces the previous one */
+  if(chunk.nodeID != _streamRx.nodeID || chunk.streamID != _streamRx.streamID
+      || _streamRx.status == STREAM_IDLE){
+    if(_streamBuffer && chunk.length > _streamBufferSize){
+      P_DEBUG("[receiveStreamChunk] ERR: Stream too large !")
+      return;
+    }
+    memset(&_streamRx, 0, sizeof(stream_state_t));
+    _streamRx.status = STREAM_BUSY;
+    _streamRx.nodeID = chunk.nodeID;
+    _streamRx.streamID = chunk.streamID;
+    _streamRx.length = chunk.length;
+  }
+  chunks = (_streamRx.length + STREAM_CHUNK_SIZE - 1) / STREAM_CHUNK_SIZE;
+  offset = chunk.seq * STREAM_CHUNK_SIZE;
+  if(chunk.seq >= chunks || length != min((uint16_t)(_streamRx.length - offset), (uint16_t)STREAM_CHUNK_SIZE)){
+    return;
+  }
+  if(chunk.seq < _streamRx.base
+      || (chunk.seq > _streamRx.base && (_streamRx.bitmap & (1U << (chunk.seq - _streamRx.base - 1))))){
+    /* Duplicate, our last acknowledgement was probably lost */
+    ackNow = true;
+  }else if(chunk.seq < _streamRx.base + STREAM_WINDOW){
+    if(_streamBuffer){
+      memcpy(_streamBuffer + offset, chunk.data, length);
+    }else if(_streamSink){
+      _streamSink(chunk.nodeID, offset, chunk.data, length);
+    }
+    if(chunk.seq == _streamRx.base){
+      _streamRx.base++;
+      while(_streamRx.bitmap & 1){
+        _streamRx.bitmap >>= 1;
+        _streamRx.base++;
+      }
+      _streamRx.bitmap >>= 1;
+    }else{
+      _streamRx.bitmap |= 1U << (chunk.seq - _streamRx.base - 1);
+      ackNow = true;
+    }
+    /* On receiver side, next counts chunks since last acknowledgement */
+    _streamRx.next++;
+  }
+  if(_streamRx.base >= chunks){
+    _streamRx.status = STREAM_DONE;
+    ackNow = true;
+  }
+  if(ackNow || _streamRx.next >= STREAM_WINDOW / 2){
+    sendStreamAck();
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendStreamAck()
+{
+  stream_ack_t ack;
+  ack.streamID = _streamRx.streamID;
+  ack.base = _streamRx.base;
+  ack.bitmap = _streamRx.bitmap;
+  _streamRx.next = 0;
+  meshWrite(&ack, STREAM_ACK_MSG_T, sizeof(stream_ack_t), _streamRx.nodeID);
+}
+#endif
+
+/***************************** Node functions *******************************/
+template <class Role>
+uint32_t RF24WaveCore<Role>::joinBackoff(uint8_t attempt)
+{
+  uint16_t slots = JOIN_SLOTS;
+  /* Window doubles after each unanswered request, so a storm spreads out */
+  while(attempt-- > 0 && slots < JOIN_MAX_SLOTS){
+    slots <<= 1;
+  }
+  return (uint32_t)random(slots) * JOIN_SLOT_TIME;
+}
+
+template <class Role>
+uint32_t RF24WaveCore<Role>::entropySeed()
+{
+  uint8_t i;
+  uint32_t seed = nodeID;
+  /* Low bits of a floating input differ between boards and boots, node ID
+   * keeps two boards apart if their inputs read the same */
+  for(i=0; i<32; i++){
+    seed = (seed << 3 | seed >> 29) ^ analogRead(WAVE_ENTROPY_PIN);
+  }
+  return seed;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::connect()
+{
+  uint8_t attempt = 0;
+  /* Nodes powered together pick different slots */
+  randomSeed(entropySeed());
+  uint32_t wait = joinBackoff(attempt);
+  while(!_role.associated){
+    uint32_t currentTimer = millis();
+    mesh.update();
+    if(currentTimer - lastTimer > wait){
+      lastTimer = currentTimer;
+      requestAssociations();
+      wait = JOIN_RETRY_DELAY + joinBackoff(++attempt);
+    }
+    confirmAssociations();
+  }
+  Serial.println(F("Node connected"));
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::isAssociated()
+{
+  return _role.associated;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::isSynchronized()
+{
+  return _role.synchronized;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::requestAssociations()
+{
+  uint8_t i;
+  ScratchLease<info_node_t> info(_scratch);
+  info.data.nodeID = nodeID;
+  for(i=0; i<MAX_GROUPS; i++){
+    info.data.groupsID[i] = _role.groupsID[i];
+  }
+  printAssociation(info.data);
+  mesh.update();
+  if(!meshWrite(&info.data, CONNECT_MSG_T, sizeof(info_node_t))){
+    // Serial.println(F("[requestAssociations] ERROR: Unable to send data"));
+    // If a write fails, check connectivity to the mesh network
+    if(!mesh.checkConnection()){
+      //refresh the network address
+      Serial.println(F("[requestAssociations] ERROR: Renewing Address"));
+      renewAddress();
+    }
+    return false;
+  }else{
+    return true;
+  }
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::confirmAssociations()
+{
+  bool available = true;
+  _role.associated = false;
+  uint8_t i = 0;
+  //mesh.update();
+  /* Frames queued behind the answer are for listen() */
+  while(!_role.associated && network.available()){
+    RF24NetworkHeader header;
+    network.peek(header);
+    if(header.type == ACK_CONNECT_MSG_T){
+        //Serial.println(F("[confirmAssociations] INFO ACK_INIT_MSG_T BEGIN"));
+        ScratchLease<info_node_t> info(_scratch);
+        network.read(header, &info.data, sizeof(info_node_t));
+        P_DEBUG("[confirmAssociations] Received payload")
+        F_DEBUG(printAssociation(info.data))
+        if(info.data.nodeID != nodeID){
+          Serial.println(F("[confirmAssociations] ERROR nodeID"));
+          available = false;
+        }
+        for(i=0; i<MAX_GROUPS; i++){
+          if(_role.groupsID[i] != info.data.groupsID[i]){
+            Serial.print(F("[confirmAssociations] ERROR groupID"));
+            Serial.println(_role.groupsID[i]);
+            available = false;
+          };
+        }
+        //Serial.println(F("[confirmAssociations] ADD LIST BEGIN"));
+        addListAssociations(info.data);
+        printAssociations();
+        _role.associated = true;
+    }else{
+      /* Nothing else concerns a node not associated yet, drop it */
+      network.read(header, 0, 0);
+    }
+  }
+  return available;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::synchronizeAssociations(){
+  uint8_t attempt = 0;
+  uint32_t wait = joinBackoff(attempt);
+  _role.synchronized = false;
+  while(!_role.synchronized){
+    uint32_t currentTimer = millis();
+    mesh.update();
+    if(currentTimer - lastTimer > wait){
+      lastTimer = currentTimer;
+      requestSynchronize();
+      wait = JOIN_RETRY_DELAY + joinBackoff(++attempt);
+    }
+    confirmSynchronize();
+  }
+  Serial.println(F("Node synchronized"));
+  printAssociations();
+  createBroadcastList();
+}
+
+template <class Role>
+void RF24WaveCore<Role>::confirmSynchronize(){
+  /* Frames queued behind the list are for listen() */
+  while(!_role.synchronized && network.available()){
+    Serial.println(F("[confirmSynchronize] Available packet !"));
+    RF24NetworkHeader header;
+    network.peek(header);
+    if(header.type == ACK_SYNCHRONIZE_MSG_T){
+        Serial.println(F("[confirmAssociations] INFO ACK_INIT_MSG_T BEGIN"));
+        ScratchLease<send_list_t> list(_scratch);
+        network.read(header, &list.data, sizeof(send_list_t));
+        if(list.data.nodeID != nodeID){
+          Serial.println(F("[confirmSynchronize] ERROR nodeID"));
+          return;
+        }
+        receiveSynchronizedList(list.data);
+        _role.synchronized = true;
+    }else{
+      /* Group updates are covered by the list being requested, drop them */
+      network.read(header, 0, 0);
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveSynchronizedList(const send_list_t &msg){
+  uint8_t i, j;
+  if(msg.nodeID == nodeID){
+    for(i=0; i<MAX_GROUPS; i++){
+      for(j=0; j<MAX_NODE_GROUPS; j++){
+        addAssociation(msg.listGroupsID[i][j], i+1);
+      }
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::requestSynchronize(){
+  uint8_t i;
+  ScratchLease<info_node_t> info(_scratch);
+  info.data.nodeID = nodeID;
+  for(i=0; i<MAX_GROUPS; i++){
+    info.data.groupsID[i] = _role.groupsID[i];
+  }
+  mesh.update();
+  Serial.println(F("[requestSynchronize] Send request"));
+  if(!meshWrite(&info.data, SYNCHRONIZE_MSG_T, sizeof(info_node_t), 0)){
+    Serial.println(F("[requestSynchronize] Send failed"));
+    // If a write fails, check connectivity to the mesh network
+    if(!mesh.checkConnection()){
+      //refresh the network address
+      Serial.println(F("[requestSynchronize] ERROR: Renewing Address"));
+      renewAddress();
+    }
+  }
+  Serial.println(F("[requestSynchronize] END"));
+}
+
+#if defined(WAVE_SEND_COALESCE)
+template <class Role>
+bool RF24WaveCore<Role>::send(MyMessage &message, bool event)
+{
+  uint8_t i;
+  send_slot_t *slot;
+  mSetCommand(message, C_SET);
+  message.sender = nodeID;
+  /* Only the newest value matters, it keeps the place of the first one */
+  for(i=0; i<_role._sendCount && !event; i++){
+    slot = &_role._sendQueue[(_role._sendHead + i) % SEND_QUEUE_SIZE];
+    if(!slot->event && slot->message.sensor == message.sensor && slot->message.type == message.type){
+      slot->message = message;
+      return true;
+    }
+  }
+  if(_role._sendCount >= SEND_QUEUE_SIZE){
+    P_DEBUG("[send] ERR: Queue full !")
+    return false;
+  }
+  slot = &_role._sendQueue[(_role._sendHead + _role._sendCount) % SEND_QUEUE_SIZE];
+  _role._sendCount++;
+  slot->message = message;
+  slot->retry = 0;
+  slot->event = event;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processSends()
+{
+  send_slot_t *slot;
+  if(!_role._sendCount){
+    return;
+  }
+  slot = &_role._sendQueue[_role._sendHead];
+  if(slot->retry && millis() - slot->timer < SEND_RETRY_DELAY){
+    return;
+  }
+#if defined(WAVE_PRESENT_BATCH)
+  /* Values wait for presentation to be acked */
+  if(!presentFlush()){
+    return;
+  }
+#endif
+  protocolFormat(slot->message);
+  mesh.update();
+  if(!meshWrite(_scratch.format.buffer, MY_MESSAGE_T, MY_GATEWAY_MAX_SEND_LENGTH, GATEWAY_ADDRESS)
+      && ++slot->retry < NB_RETRY_SEND){
+    /* Values received meanwhile replace this one before next attempt */
+    slot->timer = millis();
+    return;
+  }
+  _role._sendHead = (_role._sendHead + 1) % SEND_QUEUE_SIZE;
+  _role._sendCount--;
+}
+#else
+template <class Role>
+void RF24WaveCore<Role>::send(MyMessage &message){
+  mSetCommand(message, C_SET);
+  sendMyMessage(message, GATEWAY_ADDRESS);
+}
+#endif
+
+template <class Role>
+void RF24WaveCore<Role>::broadcastNotifications(MyMessage &message)
+{
+  createBroadcastList();
+  broadcast_list_t *currentElt = _role.headBroadcastList;
+  while(currentElt){
+    Serial.print(F("[broadcastNotifications] Send notification to "));
+    Serial.println(currentElt->nodeID);
+    sendMyMessage(message, currentElt->nodeID);
+    currentElt = currentElt->next;
+  }
+}
+
+template <class Role>
+MyMessage* RF24WaveCore<Role>::queueNotification(uint8_t childID, uint8_t type)
+{
+  uint8_t i;
+  notif_slot_t *slot;
+  /* We overwrite a pending notification of same sensor which is not being sent */
+  for(i=0; i<_role._notifCount; i++){
+    slot = &_role._notifQueue[(_role._notifHead + i) % NOTIF_QUEUE_SIZE];
+    if(!slot->started && slot->message.sensor == childID && slot->message.type == type){
+      return &slot->message;
+    }
+  }
+  if(_role._notifCount >= NOTIF_QUEUE_SIZE){
+    P_DEBUG("[queueNotification] ERR: Queue full !")
+    return NULL;
+  }
+  slot = &_role._notifQueue[(_role._notifHead + _role._notifCount) % NOTIF_QUEUE_SIZE];
+  _role._notifCount++;
+  slot->cursor = NULL;
+  slot->retry = 0;
+  slot->started = false;
+  build(slot->message, nodeID, GATEWAY_ADDRESS, childID, C_SET, type, false);
+  memset(slot->message.data, 0, sizeof(slot->message.data));
+  return &slot->message;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processNotifications()
+{
+  notif_slot_t *slot;
+  bool sent, attempt;
+#if defined(WAVE_SIGNING)
+  uint8_t size;
+#endif
+  if(!_role._notifCount){
+    return;
+  }
+  slot = &_role._notifQueue[_role._notifHead];
+  if(!slot->started){
+    slot->started = true;
+    slot->cursor = _role.headBroadcastList;
+  }
+  /* Only one frame per call so listen() never blocks on a whole group */
+  if(slot->cursor){
+    mesh.update();
+#if defined(WAVE_SIGNING)
+    ScratchLease<sign_scratch_t> sign(_scratch);
+    size = signFrame(slot->message, slot->cursor->nodeID, sign.data.frame);
+    if(size){
+      sent = meshWrite(sign.data.frame, NOTIF_MSG_T, size, slot->cursor->nodeID);
+      attempt = true;
+    }else{
+      /* Waiting for a nonce pool: only a new request counts as an attempt.
+       * Without a key, notification is dropped after NB_RETRY_SEND turns */
+      sent = false;
+      attempt = !_role._signKeyed || requestNonces(slot->cursor->nodeID);
+    }
+#else
+    sent = meshWrite(&slot->message, NOTIF_MSG_T, HEADER_SIZE + mGetLength(slot->message), slot->cursor->nodeID);
+    attempt = true;
+#endif
+    if(sent || (attempt && ++slot->retry >= NB_RETRY_SEND)){
+      slot->cursor = slot->cursor->next;
+      slot->retry = 0;
+    }
+  }
+  if(!slot->cursor){
+    _role._notifHead = (_role._notifHead + 1) % NOTIF_QUEUE_SIZE;
+    _role._notifCount--;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::createBroadcastList(){
+  Serial.println(F("[createBroadcastList] BEGIN"));
+  uint8_t i, j, currentDstID;
+  for(i=0; i<NODE_MAX_GROUPS; i++){
+    if(_role.groupsID[i] > 0){
+      for(j=0; j<MAX_NODE_GROUPS; j++){
+        currentDstID = _role.listGroupsID[i][j];
+        if((currentDstID > 0) && (currentDstID != nodeID)){
+          addNodeToBroadcastList(currentDstID);
+        }
+      }
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::addNodeToBroadcastList(uint8_t NID){
+  Serial.println(F("[addNodeToBroadcastList] BEGIN"));
+  bool found = false;
+  if(!_role.headBroadcastList){
+    Serial.println(F("[addNodeToBroadcastList] Head list NULL"));
+    _role.headBroadcastList = (broadcast_list_t*) calloc(1, sizeof(broadcast_list_t));
+    _role.headBroadcastList->nodeID = NID;
+    _role.headBroadcastList->next = NULL;
+    Serial.print(F("[addNodeToBroadcastList] Node "));
+    Serial.print(NID);
+    Serial.println(F(" added !"));
+  }
+  else{
+    broadcast_list_t *currentElt = _role.headBroadcastList;
+    while(currentElt->next && !found){
+      if(currentElt->nodeID == NID){
+        found = true;
+      }
+      currentElt = currentElt->next;
+    }
+    if(currentElt->nodeID == NID){
+      found = true;
+    }
+    if(!found){
+      currentElt->next = (broadcast_list_t*) calloc(1, sizeof(broadcast_list_t));
+      currentElt->next->nodeID = NID;
+      currentElt->next->next = NULL;
+      _role.lengthBroadcastList++;
+      Serial.print(F("[addNodeToBroadcastList] Node "));
+      Serial.print(NID);
+      Serial.println(F(" added !"));
+    }else{
+      Serial.print(F("[addNodeToBroadcastList] Node "));
+      Serial.print(NID);
+      Serial.println(F(" already added !"));
+    }
+  }
+  Serial.println(F("[addNodeToBroadcastList] END"));
+}
+
+template <class Role>
+void RF24WaveCore<Role>::printUpdate(update_msg_t data)
+{
+  Serial.println(F("# Print Update :"));
+  Serial.print(F("> NodeID: "));
+  Serial.println(data.nodeID);
+  Serial.print(F("> GroupID: "));
+  Serial.println(data.groupID);
+  Serial.println();
+}
+
+#if defined(WAVE_PRESENT_BATCH)
+/* Presentation is batched, sent by presentFlush() or next listen() */
+#define presentMessage(message) presentAdd(message)
+#else
+#define presentMessage(message) sendMyMessage(message, GATEWAY_ADDRESS)
+#endif
+
+template <class Role>
+void RF24WaveCore<Role>::sendSketchInfo(const char *name, const char *version)
+{
+  presentMessage(build(_msgTmp, nodeID, GATEWAY_ADDRESS, 255, C_PRESENTATION, S_ARDUINO_NODE, false).set(""));
+	if (name) {
+		presentMessage(build(_msgTmp, nodeID, GATEWAY_ADDRESS, 255, C_INTERNAL, I_SKETCH_NAME, false).set(name));
+	}
+	if (version) {
+		presentMessage(build(_msgTmp, nodeID, GATEWAY_ADDRESS, 255, C_INTERNAL, I_SKETCH_VERSION, false).set(version));
+	}
+}
+
+template <class Role>
+void RF24WaveCore<Role>::present(const uint8_t childId, const uint8_t sensorType, const char *description)
+{
+  presentMessage(build(_msgTmp, nodeID, GATEWAY_ADDRESS, childId, C_PRESENTATION, sensorType, false).set(description));
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendMyMessage(MyMessage &message, uint8_t destID)
+{
+  bool send = false;
+  uint8_t retry;
+#if defined(WAVE_PRESENT_BATCH)
+  /* Controller gets presentation before any value */
+  presentWait();
+#endif
+  message.sender = nodeID;
+  // mSetCommand(message, C_SET);
+  protocolFormat(message);
+  P_DEBUG("[sendMyMessage] Data send :");
+#if defined(WAVE_DEBUG)
+  Serial.print(_scratch.format.buffer);
+#endif
+  //mesh.update();
+  //send = mesh.write(_scratch.format.buffer, MY_MESSAGE_T, MY_GATEWAY_MAX_SEND_LENGTH, destID);
+  retry = 0;
+  while(!send && (retry < NB_RETRY_SEND)){
+    uint32_t currentTimer = millis();
+    mesh.update();
+    if(currentTimer - lastTimer > 2000){
+      lastTimer = currentTimer;
+      mesh.update();
+      send = meshWrite(_scratch.format.buffer, MY_MESSAGE_T, MY_GATEWAY_MAX_SEND_LENGTH, destID);
+      if(!send){
+        Serial.println(F("[sendMyMessage] Unable to send notification - Retry "));
+      }
+      retry++;
+    }
+  }
+}
+
+#if defined(WAVE_PRESENT_BATCH)
+template <class Role>
+void RF24WaveCore<Role>::presentAdd(MyMessage &message)
+{
+  uint8_t size;
+  message.sender = nodeID;
+  size = HEADER_SIZE + mGetLength(message);
+  /* A record is never split over two frames */
+  if(_role._presentLength + size > PRESENT_FRAME_SIZE && !presentWait()){
+    Serial.println(F("[presentAdd] Presentation pending, record dropped"));
+    return;
+  }
+  memcpy(_role._presentFrame + _role._presentLength, &message, size);
+  _role._presentLength += size;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::presentFlush()
+{
+  uint8_t shift;
+  if(!_role._presentLength){
+    return true;
+  }
+  /* Attempts are spaced by a delay doubled after each failure */
+  if(_role._presentRetry){
+    shift = _role._presentRetry - 1 < PRESENT_RETRY_SHIFT ? _role._presentRetry - 1 : PRESENT_RETRY_SHIFT;
+    if(millis() - _role._presentTimer < ((uint32_t)PRESENT_RETRY_DELAY << shift)){
+      return false;
+    }
+  }
+  mesh.update();
+  /* Batch is kept until acked, the network ack covers every record */
+  if(meshWrite(_role._presentFrame, PRESENT_MSG_T, _role._presentLength, GATEWAY_ADDRESS)){
+    _role._presentLength = 0;
+    _role._presentRetry = 0;
+    return true;
+  }
+  if(!_role._presentRetry){
+    Serial.println(F("[presentFlush] Unable to send presentation - Retry"));
+  }
+  _role._presentTimer = millis();
+  if(_role._presentRetry < 0xFF){
+    _role._presentRetry++;
+  }
+  return false;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::presentWait()
+{
+  uint8_t attempts = 0, retry;
+  /* Up to NB_RETRY_SEND attempts, then listen() goes on retrying */
+  while(_role._presentLength && attempts < NB_RETRY_SEND){
+    retry = _role._presentRetry;
+    if(!presentFlush() && _role._presentRetry != retry){
+      attempts++;
+    }
+    mesh.update();
+  }
+  return !_role._presentLength;
+}
+#endif
+
+template <class Role>
+void RF24WaveCore<Role>::renewAddress()
+{
+#if defined(WAVE_CHANNEL_SCAN) || defined(WAVE_RATE_ADAPT)
+  /* Master may have moved to another channel or rate since node joined */
+  if(mesh.renewAddress() == MESH_DEFAULT_ADDRESS){
+    scanMesh();
+  }
+#else
+  mesh.renewAddress();
+#endif
+}
+
+template <class Role>
+void RF24WaveCore<Role>::setHandlers(const sensor_route_t *routes, uint8_t count)
+{
+  _role._handlers = routes;
+  _role._handlerCount = routes ? count : 0;
+}
+
+template <class Role>
+sensor_handler_t RF24WaveCore<Role>::findHandler(const MyMessage &message)
+{
+  uint8_t i;
+  const sensor_route_t *route;
+  for(i=0; i<_role._handlerCount; i++){
+    route = &_role._handlers[i];
+    if((route->childID == WAVE_ANY || route->childID == message.sensor)
+        && (route->type == WAVE_ANY || route->type == message.type)
+        && (route->command == WAVE_ANY || route->command == mGetCommand(message))){
+      return route->handler;
+    }
+  }
+  return NULL;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::dispatch(const MyMessage &message)
+{
+  /* Weak receive() may not be defined, unless this unit is the sketch */
+  sensor_handler_t handler = receive;
+  if(!_role._handlers){
+    if(handler){
+      handler(message);
+    }
+    return;
+  }
+  handler = findHandler(message);
+  if(handler){
+    handler(message);
+  }else{
+    P_DEBUG("[dispatch] No handler, message dropped")
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveUpdateGroup(const update_group_msg_t &data)
+{
+  uint8_t i;
+  for(i=0; i<MAX_NODE_GROUPS; i++){
+    addAssociation(data.nodesID[i], data.groupID);
+  }
+  printAssociations();
+  createBroadcastList();
+}
+
+#if defined(WAVE_LIVENESS)
+template <class Role>
+void RF24WaveCore<Role>::leave()
+{
+  update_msg_t data;
+  data.nodeID = nodeID;
+  data.groupID = 0;
+  mesh.update();
+  if(!meshWrite(&data, LEAVE_MSG_T, sizeof(update_msg_t))){
+    Serial.println(F("[leave] ERROR: Unable to send leave"));
+  }
+  resetListGroup();
+  while(_role.headBroadcastList){
+    removeNodeFromBroadcastList(_role.headBroadcastList->nodeID);
+  }
+  _role.associated = false;
+  _role.synchronized = false;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::receiveLeave(update_msg_t data)
+{
+  uint8_t i;
+  printUpdate(data);
+  removeAssociation(data.nodeID, data.groupID);
+  /* Peer stays in broadcast list while it shares another group */
+  for(i=0; i<NODE_MAX_GROUPS; i++){
+    if(isPresent(data.nodeID, _role.groupsID[i])){
+      return;
+    }
+  }
+  removeNodeFromBroadcastList(data.nodeID);
+}
+
+template <class Role>
+void RF24WaveCore<Role>::removeNodeFromBroadcastList(uint8_t NID)
+{
+  uint8_t i;
+  notif_slot_t *slot;
+  broadcast_list_t *previous = NULL;
+  broadcast_list_t *currentElt = _role.headBroadcastList;
+  while(currentElt && currentElt->nodeID != NID){
+    previous = currentElt;
+    currentElt = currentElt->next;
+  }
+  if(!currentElt){
+    return;
+  }
+  /* Notification being sent must not keep a pointer on removed element */
+  for(i=0; i<_role._notifCount; i++){
+    slot = &_role._notifQueue[(_role._notifHead + i) % NOTIF_QUEUE_SIZE];
+    if(slot->cursor == currentElt){
+      slot->cursor = currentElt->next;
+    }
+  }
+  if(previous){
+    previous->next = currentElt->next;
+  }else{
+    _role.headBroadcastList = currentElt->next;
+  }
+  free(currentElt);
+  if(_role.lengthBroadcastList > 0){
+    _role.lengthBroadcastList--;
+  }
+  Serial.print(F("[removeNodeFromBroadcastList] Node "));
+  Serial.print(NID);
+  Serial.println(F(" removed !"));
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendHeartbeatResponse()
+{
+  build(_msgTmp, nodeID, GATEWAY_ADDRESS, 255, C_INTERNAL, I_HEARTBEAT_RESPONSE, false).set((uint32_t)millis());
+  protocolFormat(_msgTmp);
+  /* One attempt only, master asks again on next check */
+  meshWrite(_scratch.format.buffer, MY_MESSAGE_T, MY_GATEWAY_MAX_SEND_LENGTH, GATEWAY_ADDRESS);
+}
+#endif
+
+/***************************** Master functions *****************************/
+
+template <class Role>
+bool RF24WaveCore<Role>::checkAssociations(info_node_t *data)
+{
+  uint8_t i;
+  bool available = true;
+  for(i=0; i<MAX_GROUPS; i++){
+    if(!checkGroup(data->nodeID, data->groupsID[i])){
+      printLine(PSTR("[checkAssociations] ERROR Unable group!"));
+      available = false;
+      data->groupsID[i] = 0;
+    }
+  }
+  P_DEBUG("[checkAssociations] DEBUG Data before send")
+  F_DEBUG(printAssociation(*data))
+  mesh.update();
+  if(!meshWrite(data, ACK_CONNECT_MSG_T, sizeof(info_node_t), data->nodeID)){
+    printLine(PSTR("[checkAssociations] ERROR unable to send response!"));
+  }
+  return available;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::checkGroup(uint8_t ID, uint8_t group)
+{
+  uint8_t i;
+  /* if group == 0 then it's unnecessary to check if it's available */
+  if(group > 0){
+    for(i=0; i<MAX_NODE_GROUPS; i++){
+      /* We check if we can add ID to group or if ID exist in group ! */
+      if(_role.listGroupsID[group-1][i] == ID || _role.listGroupsID[group-1][i] == 0){
+        return true;
+      }
+    }
+    return false;
+  }else{
+    return true;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendSynchronizedList(info_node_t msg){
+  ScratchLease<send_list_t> list(_scratch);
+  uint8_t i, j, currentGroup;
+  mesh.update();
+  list.data.nodeID = msg.nodeID;
+  for(i=0; i<MAX_GROUPS; i++){
+    currentGroup = msg.groupsID[i];
+    /* We check if node is realy present in group */
+    if(isPresent(msg.nodeID, currentGroup)){
+      for(j=0; j<MAX_NODE_GROUPS; j++){
+        /* We copy all nodes associated with this group */
+        list.data.listGroupsID[currentGroup-1][j] = _role.listGroupsID[currentGroup-1][j];
+      }
+    }
+  }
+  if(!meshWrite(&list.data, ACK_SYNCHRONIZE_MSG_T, sizeof(send_list_t), list.data.nodeID)){
+    printLine(PSTR("[sendSynchronizedList] ERROR: Unable to send response to node !"));
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::broadcastAssociations(info_node_t data)
+{
+  uint8_t i;
+  uint8_t group = 0;
+  for(i=0; i<MAX_GROUPS; i++){
+    group = data.groupsID[i];
+    if(group > 0){
+      if(!sendUpdateGroup(data.nodeID, group, _role.listGroupsID[group-1])){
+        printLine(PSTR("[broadcastAssociations] ERR: Unable to send Update !"));
+      }
+    }
+  }
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::sendUpdateGroup(uint8_t NID, uint8_t GID, uint8_t *listNID)
+{
+  uint8_t i, currentNID;
+  update_msg_t update;
+  bool successful = true;
+  for(i=0; i<MAX_NODE_GROUPS; i++){
+    /* We catch the nodeID associated to groupID and we check if we must send update */
+    currentNID = listNID[i];
+    /* We check that we only send update to other nodes. Not original node or controller ! */
+    if((currentNID > 0) && (currentNID != NID)){
+      memset(&update, 0, sizeof(update_msg_t));
+      update.nodeID = NID;
+      update.groupID = GID;
+      if(!meshWrite(&update, UPDATE_MSG_T, sizeof(update_msg_t), currentNID)){
+        successful = false;
+        printLine(PSTR("[sendUpdateGroup] ERR: Unable to send Update !"));
+        printLine(PSTR("[sendUpdateGroup] NID: %d GID: %d"), update.nodeID, update.groupID);
+      }
+    }
+  }
+  return successful;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::printNetwork()
+{
+  uint32_t currentTimer = millis();
+  if(currentTimer - lastTimer > 5000){
+    lastTimer = currentTimer;
+    printLine(PSTR(" "));
+    printLine(PSTR("********Assigned Addresses********"));
+    for(int i=0; i<mesh.addrListTop; i++){
+      printLine(PSTR("NodeID: %d RF24Network Address: 0%o"), mesh.addrList[i].nodeID, mesh.addrList[i].address);
+    }
+#if defined(WAVE_ADMISSION)
+    printLine(PSTR("Dropped CONNECT: %u SYNCHRONIZE: %u Cached: %u"), _role._admitCounters.dropped[ADMIT_CONNECT],
+      _role._admitCounters.dropped[ADMIT_SYNCHRONIZE], _role._admitCounters.cached);
+#endif
+#if defined(WAVE_VALUE_CACHE)
+    printLine(PSTR("Value requests answered: %lu forwarded: %lu"), (unsigned long)_role._valueCacheStats.hits,
+      (unsigned long)_role._valueCacheStats.misses);
+#endif
+    printLine(PSTR("**********************************"));
+  }
+}
+
+#if defined(WAVE_JOIN_BATCH)
+/***************************** Join functions *******************************/
+
+template <class Role>
+void RF24WaveCore<Role>::queueJoin(const info_node_t &info)
+{
+  uint8_t i;
+  /* Repeated request of a queued node replaces it */
+  for(i=0; i<_role._joinCount && _role._joinQueue[i].nodeID != info.nodeID; i++);
+  if(i == JOIN_BATCH_SIZE){
+    P_DEBUG("[queueJoin] ERR: Queue full !")
+    return;
+  }
+  if(_role._joinCount == 0){
+    _role._joinTimer = millis();
+  }
+  if(i == _role._joinCount){
+    _role._joinCount++;
+  }
+  _role._joinQueue[i] = info;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processJoins()
+{
+  uint8_t i, GID, count;
+  uint8_t before[MAX_GROUPS];
+  uint8_t *row;
+  bool changed = false;
+  update_group_msg_t update;
+#if defined(WAVE_ADMISSION)
+  admit_state_t *admit;
+#endif
+  if(!_role._joinCount || (_role._joinCount < JOIN_BATCH_SIZE && millis() - _role._joinTimer < JOIN_BATCH_DELAY)){
+    return;
+  }
+  /* Rows are packed: members known before batch come first */
+  for(GID=1; GID<=MAX_GROUPS; GID++){
+    row = _role.listGroupsID[GID-1];
+    for(count=0; count<MAX_NODE_GROUPS && row[count] > 0; count++);
+    before[GID-1] = count;
+  }
+  /* Each node gets its own ACK */
+  for(i=0; i<_role._joinCount; i++){
+    F_DEBUG(printAssociation(_role._joinQueue[i]))
+    if(checkAssociations(&_role._joinQueue[i])){
+      addListAssociations(_role._joinQueue[i]);
+    }
+  }
+#if defined(WAVE_ADMISSION)
+  /* Every add bumps the epoch: cache answers once the batch is done */
+  for(i=0; i<_role._joinCount; i++){
+    admit = (admit_state_t*) admitStats(_role._joinQueue[i].nodeID);
+    if(admit){
+      cacheAnswer(admit, _role._joinQueue[i]);
+    }
+  }
+#endif
+  _role._joinCount = 0;
+  /* Older members get each changed group once; new ones synchronize */
+  for(GID=1; GID<=MAX_GROUPS; GID++){
+    row = _role.listGroupsID[GID-1];
+    for(count=0; count<MAX_NODE_GROUPS && row[count] > 0; count++);
+    if(count == before[GID-1]){
+      continue;
+    }
+    changed = true;
+    update.groupID = GID;
+    memcpy(update.nodesID, row, MAX_NODE_GROUPS);
+    for(i=0; i<before[GID-1]; i++){
+      if(!meshWrite(&update, UPDATE_GROUP_MSG_T, sizeof(update_group_msg_t), row[i])){
+        printLine(PSTR("[processJoins] ERR: Unable to send Update !"));
+      }
+    }
+  }
+  F_DEBUG(printAssociations())
+#if defined(WAVE_STANDBY_ID)
+  if(changed){
+    replicateAssociations();
+  }
+#else
+  (void)changed;
+#endif
+}
+#endif
+
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+/***************************** Liveness functions ***************************/
+
+/* Ages of stamps are kept below this many seconds, see checkLiveness() */
+#define LIVE_MAX_AGE 0xF000u
+
+static_assert(LIVE_CHECK_DELAY / 1000 < 0xFFFFu - LIVE_MAX_AGE, "Stamps would wrap between two checks");
+
+template <class Role>
+void RF24WaveCore<Role>::resetHeard()
+{
+  uint8_t i;
+  uint16_t *heard = &_role._heard[0][0];
+  /* Members known at start count as just heard */
+  for(i=0; i<MAX_GROUPS*MAX_NODE_GROUPS; i++){
+    heard[i] = (uint16_t)(millis() / 1000);
+  }
+  _role._liveTimer = millis();
+}
+
+template <class Role>
+void RF24WaveCore<Role>::markAlive(RF24NetworkHeader &header)
+{
+  uint8_t i, j;
+  int16_t NID = mesh.getNodeID(header.from_node);
+  if(NID <= 0){
+    return;
+  }
+  for(i=0; i<MAX_GROUPS; i++){
+    for(j=0; j<MAX_NODE_GROUPS; j++){
+      if(_role.listGroupsID[i][j] == NID){
+        _role._heard[i][j] = (uint16_t)(millis() / 1000);
+      }
+    }
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::checkLiveness()
+{
+  uint8_t i;
+  uint8_t *slots = &_role.listGroupsID[0][0];
+  uint16_t *heard = &_role._heard[0][0];
+  uint16_t now, age;
+#if defined(WAVE_LIVENESS)
+  uint8_t k, NID;
+#endif
+  uint32_t currentTimer = millis();
+  if(currentTimer - _role._liveTimer < LIVE_CHECK_DELAY){
+    return;
+  }
+  _role._liveTimer = currentTimer;
+  now = (uint16_t)(currentTimer / 1000);
+  /* Stamps of silent slots follow the clock, so they never wrap */
+  for(i=0; i<MAX_GROUPS*MAX_NODE_GROUPS; i++){
+    age = now - heard[i];
+    if(slots[i] > 0 && age > LIVE_MAX_AGE){
+      heard[i] = now - LIVE_MAX_AGE;
+    }
+  }
+#if defined(WAVE_LIVENESS)
+  for(i=0; i<MAX_GROUPS*MAX_NODE_GROUPS; i++){
+    NID = slots[i];
+    age = now - heard[i];
+    if(NID == 0 || (uint32_t)age * 1000 < (uint32_t)LIVE_PROBE_PERIODS * LIVE_CHECK_DELAY){
+      continue;
+    }
+    /* A node in several groups is handled once, at its first slot */
+    for(k=0; k<i && slots[k] != NID; k++);
+    if(k < i){
+      continue;
+    }
+    if((uint32_t)age * 1000 >= (uint32_t)LIVE_EVICT_PERIODS * LIVE_CHECK_DELAY){
+      /* One eviction per check, rows are packed again by it */
+      evictNode(NID);
+      return;
+    }
+    P_DEBUG("[checkLiveness] Heartbeat request")
+    _msgTmp.clear();
+    transmitMyMessage(build(_msgTmp, nodeID, NID, 255, C_INTERNAL, I_HEARTBEAT_REQUEST, false), NID);
+  }
+#endif
+}
+#endif
+
+#if defined(WAVE_LIVENESS)
+template <class Role>
+void RF24WaveCore<Role>::evictNode(uint8_t NID)
+{
+  uint8_t GID;
+  bool removed = false;
+  for(GID=1; GID<=MAX_GROUPS; GID++){
+    if(removeAssociation(NID, GID)){
+      removed = true;
+      if(!sendLeaveGroup(NID, GID, _role.listGroupsID[GID-1])){
+        printLine(PSTR("[evictNode] ERR: Unable to send Leave !"));
+      }
+    }
+  }
+  if(!removed){
+    return;
+  }
+  printLine(PSTR("[evictNode] Node %d removed from its groups"), NID);
+  snprintf_P(_scratch.format.conv, sizeof(_scratch.format.conv), PSTR("Node %d evicted"), NID);
+  gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set(_scratch.format.conv));
+  F_DEBUG(printAssociations())
+#if defined(WAVE_STANDBY_ID)
+  replicateAssociations();
+#endif
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::sendLeaveGroup(uint8_t NID, uint8_t GID, uint8_t *listNID)
+{
+  uint8_t i;
+  update_msg_t leave;
+  bool successful = true;
+  /* Only remaining members of the group hear about it */
+  for(i=0; i<MAX_NODE_GROUPS && listNID[i] > 0; i++){
+    leave.nodeID = NID;
+    leave.groupID = GID;
+    if(!meshWrite(&leave, LEAVE_MSG_T, sizeof(update_msg_t), listNID[i])){
+      successful = false;
+    }
+  }
+  return successful;
+}
+#endif
+
+#if defined(WAVE_ADMISSION)
+/***************************** Admission functions **************************/
+
+template <class Role>
+const admit_state_t* RF24WaveCore<Role>::admitStats(uint8_t NID)
+{
+  uint8_t i;
+  for(i=0; i<ADMIT_MAX_NODES; i++){
+    if(_role._admits[i].nodeID == NID){
+      return &_role._admits[i];
+    }
+  }
+  return NULL;
+}
+
+template <class Role>
+const admit_counters_t& RF24WaveCore<Role>::admitCounters()
+{
+  return _role._admitCounters;
+}
+
+template <class Role>
+admit_state_t* RF24WaveCore<Role>::findAdmit(uint8_t NID)
+{
+  uint8_t i, slot = 0;
+  uint32_t currentTimer = millis();
+  admit_state_t *admit = (admit_state_t*) admitStats(NID);
+  if(admit){
+    return admit;
+  }
+  /* Replace least recently seen node, a flooding node is always recent */
+  for(i=0; i<ADMIT_MAX_NODES; i++){
+    if(_role._admits[i].nodeID == 0xFF){
+      slot = i;
+      break;
+    }
+    if(currentTimer - _role._admits[i].lastSeen > currentTimer - _role._admits[slot].lastSeen){
+      slot = i;
+    }
+  }
+  admit = &_role._admits[slot];
+  memset(admit, 0, sizeof(admit_state_t));
+  admit->nodeID = NID;
+  memset(admit->tokens, ADMIT_BURST, sizeof(admit->tokens));
+  admit->refillTimer = currentTimer;
+  return admit;
+}
+
+template <class Role>
+admit_state_t* RF24WaveCore<Role>::admitRequest(RF24NetworkHeader &header, uint8_t NID, uint8_t cls)
+{
+  uint8_t i;
+  uint32_t periods;
+  uint32_t currentTimer = millis();
+  admit_state_t *admit;
+  /* Sender is known by its address, payload nodeID only before it has one */
+  int16_t sender = mesh.getNodeID(header.from_node);
+  if(sender >= 0){
+    NID = sender;
+  }
+  admit = findAdmit(NID);
+  periods = (currentTimer - admit->refillTimer) / ADMIT_REFILL;
+  if(periods > 0){
+    for(i=0; i<ADMIT_CLASSES; i++){
+      admit->tokens[i] = (admit->tokens[i] + periods >= ADMIT_BURST) ? ADMIT_BURST : admit->tokens[i] + periods;
+    }
+    admit->refillTimer += periods * ADMIT_REFILL;
+  }
+  admit->lastSeen = currentTimer;
+  if(admit->tokens[cls] == 0){
+    if(admit->dropped < 0xFFFF){
+      admit->dropped++;
+    }
+    if(_role._admitCounters.dropped[cls] < 0xFFFF){
+      _role._admitCounters.dropped[cls]++;
+    }
+    P_DEBUG("[admitRequest] Request dropped")
+    return NULL;
+  }
+  admit->tokens[cls]--;
+  return admit;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::answerCached(admit_state_t *admit, info_node_t &info)
+{
+  if(!admit->cached || admit->epoch != _role._assocEpoch
+      || memcmp(admit->request, info.groupsID, MAX_GROUPS) != 0){
+    memcpy(admit->request, info.groupsID, MAX_GROUPS);
+    admit->cached = false;
+    return false;
+  }
+  /* Same request and same associations: only the ACK was lost */
+  memcpy(info.groupsID, admit->answer, MAX_GROUPS);
+  if(!meshWrite(&info, ACK_CONNECT_MSG_T, sizeof(info_node_t), info.nodeID)){
+    printLine(PSTR("[answerCached] ERROR unable to send response!"));
+  }
+  if(_role._admitCounters.cached < 0xFFFF){
+    _role._admitCounters.cached++;
+  }
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::cacheAnswer(admit_state_t *admit, const info_node_t &info)
+{
+  memcpy(admit->answer, info.groupsID, MAX_GROUPS);
+  admit->epoch = _role._assocEpoch;
+  admit->cached = true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::admitBegin()
+{
+  uint8_t i;
+  for(i=0; i<ADMIT_MAX_NODES; i++){
+    memset(&_role._admits[i], 0, sizeof(admit_state_t));
+    _role._admits[i].nodeID = 0xFF;
+  }
+  memset(&_role._admitCounters, 0, sizeof(admit_counters_t));
+}
+#endif
+
+#if defined(WAVE_SNAPSHOT)
+/***************************** Snapshot functions ***************************/
+
+template <class Role>
+bool RF24WaveCore<Role>::snapshotNode(uint8_t index, snapshot_node_t &node)
+{
+  uint8_t i, j;
+  uint16_t age;
+#if defined(WAVE_LINK_QUALITY)
+  const link_stats_t *link;
+#endif
+  static_assert(MAX_GROUPS <= 16, "Groups do not fit snapshot_node_t");
+  if(index >= mesh.addrListTop){
+    return false;
+  }
+  node.nodeID = mesh.addrList[index].nodeID;
+  node.address = mesh.addrList[index].address;
+  node.groups = 0;
+  /* Only slots of listGroupsID are stamped, a node in no group is unknown */
+  node.seen = 0xFFFF;
+  for(i=0; i<MAX_GROUPS; i++){
+    for(j=0; j<MAX_NODE_GROUPS; j++){
+      if(_role.listGroupsID[i][j] == node.nodeID){
+        node.groups |= 1 << i;
+        age = (uint16_t)(millis() / 1000) - _role._heard[i][j];
+        node.seen = min(node.seen, age);
+      }
+    }
+  }
+  node.quality = 255;
+  node.strength = 255;
+#if defined(WAVE_LINK_QUALITY)
+  link = linkStats(node.nodeID);
+  if(link){
+    node.quality = link->quality;
+    node.strength = link->strength;
+  }
+#endif
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendSnapshot()
+{
+  snapshot_node_t node;
+  uint8_t record[SNAPSHOT_RECORD_SIZE];
+  uint8_t count = 0;
+  /* One line per node, child is its ID, then one line with the count */
+  while(snapshotNode(count, node)){
+    record[0] = node.nodeID;
+    record[1] = (uint8_t)node.address;
+    record[2] = (uint8_t)(node.address >> 8);
+    record[3] = (uint8_t)node.groups;
+    record[4] = (uint8_t)(node.groups >> 8);
+    record[5] = (uint8_t)node.seen;
+    record[6] = (uint8_t)(node.seen >> 8);
+    record[7] = node.quality;
+    record[8] = node.strength;
+    gatewayTransportSend(build(_msgTmp, GATEWAY_ADDRESS, GATEWAY_ADDRESS, node.nodeID, C_STREAM,
+      SNAPSHOT_STREAM_TYPE, false).set(record, SNAPSHOT_RECORD_SIZE));
+    count++;
+  }
+  gatewayTransportSend(build(_msgTmp, GATEWAY_ADDRESS, GATEWAY_ADDRESS, 255, C_STREAM,
+    SNAPSHOT_STREAM_TYPE, false).set(count));
+}
+#endif
+
+#if defined(WAVE_VALUE_CACHE)
+/***************************** Value cache functions ************************/
+
+template <class Role>
+const value_cache_stats_t& RF24WaveCore<Role>::valueCacheStats()
+{
+  return _role._valueCacheStats;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::cacheValue(char *line)
+{
+  value_cache_t *entry = NULL;
+  uint8_t i;
+  if(!protocolParse(_msgTmp, line) || mGetCommand(_msgTmp) != C_SET){
+    return;
+  }
+  /* Line of a node starts with its ID, parsed as destination */
+  _msgTmp.sender = _msgTmp.destination;
+  _msgTmp.destination = GATEWAY_ADDRESS;
+  for(i=0; i<_role._valueCacheCount && !entry; i++){
+    if(_role._valueCache[i].message.sender == _msgTmp.sender && _role._valueCache[i].message.sensor == _msgTmp.sensor
+        && _role._valueCache[i].message.type == _msgTmp.type){
+      entry = &_role._valueCache[i];
+    }
+  }
+  if(!entry && _role._valueCacheCount < VALUE_CACHE_SIZE){
+    entry = &_role._valueCache[_role._valueCacheCount++];
+  }
+  if(!entry){
+    entry = &_role._valueCache[0];
+    for(i=1; i<_role._valueCacheCount; i++){
+      if(millis() - _role._valueCache[i].time > millis() - entry->time){
+        entry = &_role._valueCache[i];
+      }
+    }
+  }
+  entry->message = _msgTmp;
+  entry->time = millis();
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::answerFromCache(MyMessage &message)
+{
+  uint8_t i;
+  value_cache_t *entry;
+  for(i=0; i<_role._valueCacheCount; i++){
+    entry = &_role._valueCache[i];
+    if(entry->message.sender == message.destination && entry->message.sensor == message.sensor
+        && entry->message.type == message.type){
+      if(millis() - entry->time > VALUE_CACHE_MAX_AGE){
+        break;
+      }
+      _role._valueCacheStats.hits++;
+      gatewayTransportSend(entry->message);
+      return true;
+    }
+  }
+  _role._valueCacheStats.misses++;
+  return false;
+}
+#endif
+
+#if defined(WAVE_CAPTURE)
+/***************************** Capture functions ****************************/
+
+static_assert(CAPTURE_RING_SIZE >= CAPTURE_HEADER_SIZE + CAPTURE_PAYLOAD, "Ring must hold the biggest record");
+
+template <class Role>
+void RF24WaveCore<Role>::setCaptureSink(capture_sink_t sink)
+{
+  _role._captureSink = sink;
+}
+
+template <class Role>
+const capture_stats_t& RF24WaveCore<Role>::captureStats()
+{
+  return _role._captureStats;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::captureHeader(uint8_t *record, uint32_t time, uint16_t from, uint8_t NID, uint8_t type, uint8_t size)
+{
+  uint8_t i;
+  for(i=0; i<4; i++){
+    record[i] = (uint8_t)(time >> (8 * i));
+  }
+  record[4] = (uint8_t)from;
+  record[5] = (uint8_t)(from >> 8);
+  record[6] = NID;
+  record[7] = type;
+  record[8] = size;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::captureRecord(const uint8_t *record, uint8_t length)
+{
+  uint16_t i;
+  if(_role._captureSink){
+    _role._captureSink(record, length);
+    _role._captureStats.captured++;
+    return;
+  }
+  /* Size byte of header is trusted by captureRead(), record must match it */
+  if(length < CAPTURE_HEADER_SIZE || length > CAPTURE_HEADER_SIZE + CAPTURE_PAYLOAD
+      || length != CAPTURE_HEADER_SIZE + record[CAPTURE_HEADER_SIZE - 1]){
+    _role._captureStats.dropped++;
+    return;
+  }
+  /* Oldest records make room, a record is never kept in part */
+  while(CAPTURE_RING_SIZE - _role._captureCount < length){
+    i = CAPTURE_HEADER_SIZE + _role._captureRing[(_role._captureHead + CAPTURE_HEADER_SIZE - 1) % CAPTURE_RING_SIZE];
+    _role._captureHead = (_role._captureHead + i) % CAPTURE_RING_SIZE;
+    _role._captureCount -= i;
+    _role._captureStats.dropped++;
+  }
+  for(i=0; i<length; i++){
+    _role._captureRing[(_role._captureHead + _role._captureCount + i) % CAPTURE_RING_SIZE] = record[i];
+  }
+  _role._captureCount += length;
+  _role._captureStats.captured++;
+}
+
+template <class Role>
+uint16_t RF24WaveCore<Role>::captureRead(uint8_t *buffer, uint16_t size)
+{
+  uint16_t length, read = 0, i;
+  /* Whole records only, oldest first */
+  while(_role._captureCount){
+    length = CAPTURE_HEADER_SIZE + _role._captureRing[(_role._captureHead + CAPTURE_HEADER_SIZE - 1) % CAPTURE_RING_SIZE];
+    if(read + length > size){
+      break;
+    }
+    for(i=0; i<length; i++){
+      buffer[read + i] = _role._captureRing[(_role._captureHead + i) % CAPTURE_RING_SIZE];
+    }
+    read += length;
+    _role._captureHead = (_role._captureHead + length) % CAPTURE_RING_SIZE;
+    _role._captureCount -= length;
+  }
+  return read;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::captureFrame(RF24NetworkHeader &header)
+{
+  uint8_t record[CAPTURE_HEADER_SIZE + CAPTURE_PAYLOAD];
+  uint16_t size = network.peek(header);
+  int16_t NID = mesh.getNodeID(header.from_node);
+  if(size > CAPTURE_PAYLOAD){
+    size = CAPTURE_PAYLOAD;
+  }
+  /* Frame stays queued for listen(), only a copy is recorded */
+  network.peek(header, record + CAPTURE_HEADER_SIZE, size);
+  captureHeader(record, millis(), header.from_node, NID < 0 ? 255 : NID, header.type, size);
+  captureRecord(record, CAPTURE_HEADER_SIZE + size);
+}
+#endif
+
+#if defined(WAVE_GATEWAY_TCP)
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportInit()
+{
+  memset(_role._clientInputPos, 0, sizeof(_role._clientInputPos));
+  _role._server.begin();
+}
+
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportAccept()
+{
+  uint8_t i;
+  EthernetClient client = _role._server.accept();
+  if(!client){
+    return;
+  }
+  for(i=0; i<MY_GATEWAY_MAX_CLIENTS; i++){
+    if(!_role._clients[i].connected()){
+      _role._clients[i].stop();
+      _role._clients[i] = client;
+      _role._clientInputPos[i] = 0;
+#if defined(WAVE_TIME_SYNC)
+      _role._fireAt[i] = 0;
+#endif
+      gatewayClientWrite(i, protocolFormat(buildGw(_msgTmp, I_GATEWAY_READY).set(MSG_GW_STARTUP_COMPLETE)));
+      return;
+    }
+  }
+  P_DEBUG("[gatewayTransportAccept] ERR: Too many clients !")
+  client.stop();
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::gatewayTransportAvailable()
+{
+  uint8_t i, n;
+  char inChar;
+  gatewayTransportAccept();
+  /* Clients are served in turn, one message per call */
+  for(n=0; n<MY_GATEWAY_MAX_CLIENTS; n++){
+    i = _role._clientIndex;
+    _role._clientIndex = (_role._clientIndex + 1) % MY_GATEWAY_MAX_CLIENTS;
+    while(_role._clients[i].connected() && _role._clients[i].available()){
+      inChar = (char)_role._clients[i].read();
+      if (_role._clientInputPos[i] < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
+        if (inChar == '\n') {
+          _role._clientBuffer[i][_role._clientInputPos[i]] = 0;
+          _role._clientInputPos[i] = 0;
+          if(protocolParse(_msgTmp, _role._clientBuffer[i])){
+            _role._clientFrom = i;
+            return true;
+          }
+        } else {
+          _role._clientBuffer[i][_role._clientInputPos[i]] = inChar;
+          _role._clientInputPos[i]++;
+        }
+      } else {
+        // Incoming message too long. Throw away
+        _role._clientInputPos[i] = 0;
+      }
+    }
+  }
+  return false;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportWrite(const char *data)
+{
+  uint8_t i;
+  for(i=0; i<MY_GATEWAY_MAX_CLIENTS; i++){
+    if(_role._clients[i].connected()){
+      gatewayClientWrite(i, data);
+    }
+  }
+}
+
+/* A line is written whole or not at all, else the parser of the controller
+ * loses its place: a client taking only part of it is dropped */
+template <class Role>
+void RF24WaveCore<Role>::gatewayClientWrite(uint8_t i, const char *data)
+{
+  size_t length = strlen(data);
+  size_t written = _role._clients[i].write((const uint8_t *)data, length);
+  if(written > 0 && written < length){
+    P_DEBUG("[gatewayClientWrite] ERR: Line cut, client dropped !")
+    _role._clients[i].stop();
+  }
+}
+
+#else
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportInit()
+{
+	gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(MSG_GW_STARTUP_COMPLETE));
+	// Send presentation of locally attached sensors (and node if applicable)
+	//presentNode();
+}
+
+#if defined(WAVE_TX_QUEUE)
+/* Radio loop never waits on serial: lines wait here for room in TX buffer */
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportWrite(const char *data)
+{
+  uint16_t i, length = strlen(data);
+  if(length > 255 || length >= GATEWAY_TX_QUEUE_SIZE){
+    _role._txStats.dropped++;
+    return;
+  }
+  if(!_role._txCount && Serial.availableForWrite() >= (int)length){
+    Serial.write((const uint8_t *)data, length);
+    _role._txStats.written++;
+    return;
+  }
+  while(GATEWAY_TX_QUEUE_SIZE - _role._txCount < length + 1){
+    _role._txStats.dropped++;
+#if GATEWAY_TX_DROP_OLDEST
+    i = 1 + _role._txQueue[_role._txHead];
+    _role._txHead = (_role._txHead + i) % GATEWAY_TX_QUEUE_SIZE;
+    _role._txCount -= i;
+#else
+    return;
+#endif
+  }
+  _role._txQueue[(_role._txHead + _role._txCount) % GATEWAY_TX_QUEUE_SIZE] = length;
+  for(i=0; i<length; i++){
+    _role._txQueue[(_role._txHead + _role._txCount + 1 + i) % GATEWAY_TX_QUEUE_SIZE] = data[i];
+  }
+  _role._txCount += length + 1;
+  if(_role._txCount > _role._txStats.peak){
+    _role._txStats.peak = _role._txCount;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportFlush()
+{
+  uint16_t i, length;
+  /* Whole lines only, so dropping the oldest never cuts one */
+  while(_role._txCount){
+    length = _role._txQueue[_role._txHead];
+    if(Serial.availableForWrite() < (int)length){
+      break;
+    }
+    for(i=1; i<=length; i++){
+      Serial.write(_role._txQueue[(_role._txHead + i) % GATEWAY_TX_QUEUE_SIZE]);
+    }
+    _role._txHead = (_role._txHead + length + 1) % GATEWAY_TX_QUEUE_SIZE;
+    _role._txCount -= length + 1;
+    _role._txStats.written++;
+  }
+}
+
+template <class Role>
+const tx_queue_stats_t& RF24WaveCore<Role>::txQueueStats()
+{
+  return _role._txStats;
+}
+#else
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportWrite(const char *data)
+{
+  Serial.print(data);
+}
+#endif
+
+template <class Role>
+bool RF24WaveCore<Role>::gatewayTransportAvailable(void)
+{
+  char inChar;
+	while (Serial.available()) {
+		// get the new byte:
+		inChar = (char)Serial.read();
+		// if the incoming character is a newline, set a flag
+		// so the main loop can do something about it:
+		if (_role._serialInputPos < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
+			if (inChar == '\n') {
+				_role._serialBuffer[_role._serialInputPos] = 0;
+        _role._serialInputPos = 0;
+				return protocolParse(_msgTmp, _role._serialBuffer);
+			} else {
+				// add it to the inputString:
+				_role._serialBuffer[_role._serialInputPos] = inChar;
+				_role._serialInputPos++;
+			}
+		} else {
+			// Incoming message too long. Throw away
+			_role._serialInputPos = 0;
+		}
+	}
+	return false;
+}
+#endif
+
+template <class Role>
+MyMessage& RF24WaveCore<Role>::buildGw(MyMessage &msg, const uint8_t type)
+{
+	msg.sender = GATEWAY_ADDRESS;
+	msg.destination = GATEWAY_ADDRESS;
+	msg.sensor = 255;
+	msg.type = type;
+	mSetCommand(msg, C_INTERNAL);
+	mSetRequestAck(msg, false);
+	mSetAck(msg, false);
+	return msg;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::gatewayTransportSend(MyMessage &message)
+{
+	gatewayTransportWrite(protocolFormat(message));
+}
+
+template <class Role>
+MyMessage& RF24WaveCore<Role>::gatewayTransportReceive()
+{
+	// Return the last parsed message
+	return _msgTmp;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::transmitMyMessage(MyMessage &message, uint8_t destID)
+{
+  message.sender = nodeID;
+  protocolFormat(message);
+  mesh.update();
+  if(!meshWrite(_scratch.format.buffer, MY_MESSAGE_T, MY_GATEWAY_MAX_SEND_LENGTH, destID)){
+    printLine(PSTR("[sendMyMessage] Unable to send notification - Retry"));
+  }
+}
+
+#if defined(WAVE_PRESENT_BATCH)
+template <class Role>
+void RF24WaveCore<Role>::presentExpand(const uint8_t *frame, uint8_t size)
+{
+  const MyMessage *record;
+  uint8_t offset = 0, length;
+  /* Each record is a binary MyMessage, forwarded as one line */
+  while(offset + HEADER_SIZE <= size){
+    record = reinterpret_cast<const MyMessage *>(frame + offset);
+    length = mGetLength((*record));
+    if(length > MAX_PAYLOAD || offset + HEADER_SIZE + length > size){
+      P_DEBUG("[presentExpand] ERR: Truncated record")
+      break;
+    }
+    _msgTmp.clear();
+    memcpy((void *)&_msgTmp, frame + offset, HEADER_SIZE + length);
+    gatewayTransportSend(_msgTmp);
+    offset += HEADER_SIZE + length;
+  }
+}
+#endif
+
+#if defined(WAVE_TIME_SYNC)
+template <class Role>
+bool RF24WaveCore<Role>::queueGroupCommand(MyMessage &message, uint32_t fireAt)
+#else
+template <class Role>
+bool RF24WaveCore<Role>::queueGroupCommand(MyMessage &message)
+#endif
+{
+  group_cmd_t *cmd;
+  if(_role._groupCmdCount >= GROUP_CMD_QUEUE_SIZE){
+    gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set("Group queue full"));
+    return false;
+  }
+  cmd = &_role._groupCmdQueue[(_role._groupCmdHead + _role._groupCmdCount) % GROUP_CMD_QUEUE_SIZE];
+  cmd->message = message;
+  memcpy(cmd->members, _role.listGroupsID[message.destination - GROUP_ADDRESS_BASE - 1], MAX_NODE_GROUPS);
+  cmd->retry = 0;
+#if defined(WAVE_TIME_SYNC)
+  cmd->fireAt = fireAt;
+#endif
+  _role._groupCmdCount++;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::processGroupCommands()
+{
+  group_cmd_t *cmd;
+  uint8_t i, NID;
+  bool sent;
+  if(!_role._groupCmdCount){
+    return;
+  }
+  cmd = &_role._groupCmdQueue[_role._groupCmdHead];
+  for(i=0; i<MAX_NODE_GROUPS && cmd->members[i] == 0; i++);
+  /* Only one frame per call so radio keeps being serviced between members */
+  if(i < MAX_NODE_GROUPS){
+    NID = cmd->members[i];
+    cmd->message.sender = nodeID;
+    mesh.update();
+#if defined(WAVE_TIME_SYNC)
+    if(cmd->fireAt){
+      sent = sendFire(cmd, NID);
+    }else
+#endif
+    {
+      protocolFormat(cmd->message);
+      sent = meshWrite(_scratch.format.buffer, MY_MESSAGE_T, MY_GATEWAY_MAX_SEND_LENGTH, NID);
+    }
+    if(sent){
+      reportGroupCommand(cmd->message, NID, true);
+      cmd->members[i] = 0;
+      cmd->retry = 0;
+    }else if(++cmd->retry >= NB_RETRY_SEND){
+      reportGroupCommand(cmd->message, NID, false);
+      cmd->members[i] = 0;
+      cmd->retry = 0;
+    }
+  }
+  for(; i<MAX_NODE_GROUPS && cmd->members[i] == 0; i++);
+  if(i >= MAX_NODE_GROUPS){
+    _role._groupCmdHead = (_role._groupCmdHead + 1) % GROUP_CMD_QUEUE_SIZE;
+    _role._groupCmdCount--;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::reportGroupCommand(MyMessage &message, uint8_t NID, bool delivered)
+{
+  if(delivered){
+    /* Delivered command is echoed to controller as an ack from member */
+    _msgTmp = message;
+    _msgTmp.sender = NID;
+    mSetAck(_msgTmp, true);
+    gatewayTransportSend(_msgTmp);
+  }else{
+    snprintf_P(_scratch.format.conv, sizeof(_scratch.format.conv), PSTR("Group %d: node %d failed"),
+               message.destination - GROUP_ADDRESS_BASE, NID);
+    gatewayTransportSend(buildGw(_msgTmp, I_LOG_MESSAGE).set(_scratch.format.conv));
+  }
+}
+
+#if defined(WAVE_LIVENESS)
+template <class Role>
+void RF24WaveCore<Role>::forgetMember(uint8_t NID, uint8_t GID)
+{
+  uint8_t i, j;
+  group_cmd_t *cmd;
+  /* Pending fan-outs and update stop at a node which left the group */
+  for(i=0; i<_role._groupCmdCount; i++){
+    cmd = &_role._groupCmdQueue[(_role._groupCmdHead + i) % GROUP_CMD_QUEUE_SIZE];
+    if(cmd->message.destination - GROUP_ADDRESS_BASE != GID){
+      continue;
+    }
+    for(j=0; j<MAX_NODE_GROUPS; j++){
+      if(cmd->members[j] == NID){
+        cmd->members[j] = 0;
+      }
+    }
+  }
+#if defined(WAVE_OTA)
+  if(_ota.status != OTA_IDLE && _ota.groupID == GID){
+    for(j=0; j<MAX_NODE_GROUPS; j++){
+      if(_role._otaPull[j].nodeID == NID){
+        _role._otaPull[j].nodeID = 0;
+      }
+    }
+  }
+#endif
+}
+#endif
+
+#if defined(WAVE_STANDBY_ID)
+template <class Role>
+void RF24WaveCore<Role>::replicateAssociations()
+{
+  ScratchLease<send_list_t> list(_scratch);
+  list.data.nodeID = WAVE_STANDBY_ID;
+  memcpy(list.data.listGroupsID, _role.listGroupsID, sizeof(_role.listGroupsID));
+  mesh.update();
+  if(!meshWrite(&list.data, REPLICATE_MSG_T, sizeof(send_list_t), WAVE_STANDBY_ID)){
+    P_DEBUG("[replicateAssociations] ERR: Unable to reach standby !")
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::sendHeartbeat()
+{
+  heartbeat_msg_t payload;
+  uint32_t currentTimer = millis();
+  if(currentTimer - _role._lastHeartbeat > STANDBY_HEARTBEAT_DELAY){
+    _role._lastHeartbeat = currentTimer;
+    memset(&payload, 0, sizeof(heartbeat_msg_t));
+    /* One DHCP entry per heartbeat, in turn */
+    if(mesh.addrListTop > 0){
+      _role._heartbeatIndex %= mesh.addrListTop;
+      payload.nodeID = mesh.addrList[_role._heartbeatIndex].nodeID;
+      payload.address = mesh.addrList[_role._heartbeatIndex].address;
+      _role._heartbeatIndex++;
+    }
+    meshWrite(&payload, MASTER_HEARTBEAT_MSG_T, sizeof(heartbeat_msg_t), WAVE_STANDBY_ID);
+  }
+}
+#endif
+
+#if defined(WAVE_STANDBY_ID)
+/***************************** Standby functions ****************************/
+
+template <class Role>
+bool RF24WaveCore<Role>::prepareBegin(StandbyPolicy)
+{
+  prepareBegin(MasterPolicy());
+  /* Standby joins as a regular node until master is lost */
+  _role._standby = true;
+  nodeID = WAVE_STANDBY_ID;
+  return true;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::joinMesh(StandbyPolicy)
+{
+  joinMesh(NodePolicy());
+}
+
+template <class Role>
+void RF24WaveCore<Role>::announce(StandbyPolicy)
+{
+  _role._lastHeartbeat = millis();
+  meshWrite(&nodeID, STANDBY_MSG_T, sizeof(nodeID));
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::updateRole(StandbyPolicy)
+{
+  updateMesh();
+  if(_role._standby){
+    listenStandby();
+    return false;
+  }
+  mesh.DHCP();
+  return true;
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::isStandby()
+{
+  return _role._standby;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::listenStandby()
+{
+  heartbeat_msg_t heartbeat;
+  while(network.available()){
+    RF24NetworkHeader header;
+    network.peek(header);
+    switch(header.type){
+      case REPLICATE_MSG_T:
+        {
+          ScratchLease<send_list_t> list(_scratch);
+          P_DEBUG("[listenStandby] REPLICATE_MSG_T")
+          network.read(header, &list.data, sizeof(send_list_t));
+          memcpy(_role.listGroupsID, list.data.listGroupsID, sizeof(_role.listGroupsID));
+        }
+        _role._replicated = true;
+        _role._lastHeartbeat = millis();
+        F_DEBUG(printAssociations())
+        break;
+      case MASTER_HEARTBEAT_MSG_T:
+        network.read(header, &heartbeat, sizeof(heartbeat_msg_t));
+        mirrorAddress(heartbeat);
+        _role._lastHeartbeat = millis();
+        _role._probeFailures = 0;
+        if(!_role._replicated){
+          meshWrite(&nodeID, STANDBY_MSG_T, sizeof(nodeID));
+        }
+        break;
+#if defined(WAVE_RATE_ADAPT)
+      case RATE_MSG_T:
+        {
+          uint8_t rate;
+          network.read(header, &rate, sizeof(rate));
+          receiveRate(rate);
+        }
+        break;
+#endif
+      default:
+        /* Standby only mirrors master, other traffic is dropped */
+        network.read(header, 0, 0);
+        break;
+    }
+  }
+  if(millis() - _role._lastHeartbeat > STANDBY_TIMEOUT && masterLost()){
+    takeover();
+  }
+}
+
+template <class Role>
+bool RF24WaveCore<Role>::masterLost()
+{
+  uint32_t currentTimer = millis();
+  if(_role._probeFailures > 0 && currentTimer - _role._lastProbe <= STANDBY_PROBE_DELAY){
+    return false;
+  }
+  _role._lastProbe = currentTimer;
+  /* Only heartbeats were lost: master acks and replicates again */
+  if(meshWrite(&nodeID, STANDBY_MSG_T, sizeof(nodeID))){
+    P_DEBUG("[masterLost] Heartbeats lost, master still up")
+    _role._lastHeartbeat = currentTimer;
+    _role._probeFailures = 0;
+    return false;
+  }
+  _role._probeFailures++;
+  return _role._probeFailures >= STANDBY_PROBES;
+}
+
+template <class Role>
+void RF24WaveCore<Role>::mirrorAddress(heartbeat_msg_t data)
+{
+  uint8_t i;
+  if(data.nodeID == 0){
+    return;
+  }
+  for(i=0; i<_role._addrMirrorTop; i++){
+    if(_role._addrMirror[i].nodeID == data.nodeID){
+      _role._addrMirror[i].address = data.address;
+      return;
+    }
+  }
+  if(_role._addrMirrorTop < STANDBY_MAX_NODES){
+    _role._addrMirror[_role._addrMirrorTop] = data;
+    _role._addrMirrorTop++;
+  }
+}
+
+template <class Role>
+void RF24WaveCore<Role>::takeover()
+{
+  uint8_t i;
+  printLine(PSTR("[takeover] Master lost, taking over node 0"));
+  _role._standby = false;
+  nodeID = GATEWAY_ADDRESS;
+  mesh.setNodeID(nodeID);
+  /* Stay on channel and data rate master was using */
+  mesh.begin(radio.getChannel(), radio.getDataRate());
+#if defined(AMPLIFICATOR)
+  radio.setPALevel(RF24_PA_LOW);
+#endif
+#if defined(WAVE_LINK_QUALITY)
+  linkBegin();
+#endif
+#if defined(WAVE_RATE_ADAPT)
+  _role._rateTimer = millis();
+#endif
+  /* Nodes keep their addresses, so routing continues without re-join */
+  for(i=0; i<_role._addrMirrorTop; i++){
+    mesh.setStaticAddress(_role._addrMirror[i].nodeID, _role._addrMirror[i].address);
+  }
+#if defined(WAVE_LIVENESS) || defined(WAVE_SNAPSHOT)
+  resetHeard();
+#endif
+  F_DEBUG(printAssociations())
+  gatewayTransportInit();
+#if defined(WAVE_TIME_SYNC)
+  gatewayTransportSend(buildGw(_msgTmp, I_TIME));
+#endif
+}
+#endif
+
+}